@@ -0,0 +1,54 @@
+#include <libdragon.h>
+#include <malloc.h>
+
+#include "arena.h"
+
+/*
+ * Bump allocator: one block up front, allocations only move `top` forward,
+ * and everything past a mark is released at once by moving it back.
+ */
+struct arena arena_create(const size_t size)
+{
+        struct arena ar;
+
+        ar.buf = memalign(ARENA_ALIGN, size);
+        ar.size = (ar.buf) ? size : 0;
+        ar.top = 0;
+        ar.high_water = 0;
+
+        return ar;
+}
+
+void arena_destroy(struct arena *ar)
+{
+        free(ar->buf);
+        ar->buf = NULL;
+        ar->size = 0;
+        ar->top = 0;
+}
+
+void *arena_alloc(struct arena *ar, const size_t size)
+{
+        size_t start;
+
+        start = (ar->top + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+        assertf(start + size <= ar->size,
+                "Arena out of memory (%u + %u > %u bytes)",
+                (unsigned)start, (unsigned)size, (unsigned)ar->size);
+
+        ar->top = start + size;
+        if (ar->top > ar->high_water)
+                ar->high_water = ar->top;
+
+        return ar->buf + start;
+}
+
+size_t arena_mark(const struct arena *ar)
+{
+        return ar->top;
+}
+
+void arena_reset(struct arena *ar, const size_t mark)
+{
+        ar->top = mark;
+}
@@ -0,0 +1,22 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGN 16 /* Data cache line */
+
+struct arena {
+        uint8_t *buf;
+        size_t size;
+        size_t top;
+        size_t high_water;
+};
+
+struct arena arena_create(const size_t size);
+void arena_destroy(struct arena *ar);
+void *arena_alloc(struct arena *ar, const size_t size);
+size_t arena_mark(const struct arena *ar);
+void arena_reset(struct arena *ar, const size_t mark);
+
+#endif /* ARENA_H */
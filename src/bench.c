@@ -0,0 +1,867 @@
+#ifdef DEBUG
+
+#include <libdragon.h>
+
+#include "bench.h"
+#include "clip.h"
+#include "gjk.h"
+#include "gjk_fixed.h"
+#include "manifold.h"
+#include "max_dot.h"
+#include "mpr.h"
+#include "narrowphase.h"
+#include "workers.h"
+#include "world.h"
+
+#define BENCH_SHAPE_MAX 16
+
+struct bench_pair_stats {
+        uint32_t calls;
+        uint32_t hits;
+        uint32_t ticks;
+};
+
+static uint32_t bench_rand_state;
+
+/* Deterministic, so runs can be compared against each other. */
+static float bench_randf(void)
+{
+        bench_rand_state = bench_rand_state * 1664525u + 1013904223u;
+
+        return (float)(bench_rand_state >> 8) / (float)(1u << 23) - 1.f;
+}
+
+static float bench_ticks_to_us(const uint32_t ticks, const uint32_t cnt)
+{
+        if (!cnt)
+                return 0.f;
+
+        return (float)ticks * 1000000.f / TICKS_PER_SECOND / cnt;
+}
+
+static int bench_make_shapes(struct shape *out,
+                             const struct collision_hull **hulls,
+                             const int hull_cnt)
+{
+        static const T3DVec3 box_axes[3] = {
+                {{.8f, .6f, 0.f}}, {{-.6f, .8f, 0.f}}, {{0.f, 0.f, 1.f}}
+        };
+        static const T3DVec3 box_half = {{.5f, .4f, .3f}};
+        static const T3DVec3 origin = {{0.f, 0.f, 0.f}};
+        int cnt;
+
+        cnt = 0;
+        for (int i = 0; i < hull_cnt && cnt < BENCH_SHAPE_MAX - 6; ++i)
+                out[cnt++] = shape_make_hull(hulls[i], &origin);
+
+        /* The first hull again, sphere-swept */
+        if (cnt) {
+                out[cnt] = out[0];
+                shape_set_margin(out + cnt++, BENCH_MARGIN);
+        }
+
+        out[cnt++] = shape_make_sphere(.5f, &origin);
+        out[cnt++] = shape_make_capsule(.3f, .4f, &origin);
+        out[cnt++] = shape_make_box(&box_half, &origin, box_axes);
+        out[cnt++] = shape_make_cylinder(.4f, .5f, &origin);
+        out[cnt++] = shape_make_cone(.4f, .5f, &origin);
+
+        return cnt;
+}
+
+static void bench_narrowphase(const struct shape *shapes, const int shape_cnt)
+{
+        static struct bench_pair_stats stats[SHAPE_TYPE_COUNT]
+                                            [SHAPE_TYPE_COUNT];
+
+        memset(stats, 0, sizeof(stats));
+        for (int i = 0; i < shape_cnt; ++i) {
+                for (int j = 0; j < shape_cnt; ++j) {
+                        struct bench_pair_stats *st;
+                        struct shape a, b;
+
+                        a = shapes[i];
+                        b = shapes[j];
+                        st = &stats[a.type][b.type];
+                        for (int k = 0; k < BENCH_ITER_CNT; ++k) {
+                                struct contact c;
+                                uint32_t start;
+
+                                for (int l = 0; l < 3; ++l)
+                                        b.pos.v[l] = bench_randf() *
+                                                     BENCH_SPREAD;
+
+                                start = get_ticks();
+                                st->hits += narrowphase_collide(&c, &a, &b);
+                                st->ticks += TICKS_DISTANCE(start,
+                                                            get_ticks());
+                                ++st->calls;
+                        }
+                }
+        }
+
+        debugf("Narrowphase, per pair type:\n");
+        debugf("%-9s %-9s %7s %7s %9s\n", "A", "B", "calls", "hits", "us/call");
+        for (int i = 0; i < SHAPE_TYPE_COUNT; ++i) {
+                for (int j = 0; j < SHAPE_TYPE_COUNT; ++j) {
+                        const struct bench_pair_stats *st;
+
+                        st = &stats[i][j];
+                        if (!st->calls)
+                                continue;
+
+                        debugf("%-9s %-9s %7lu %7lu %9.2f\n",
+                               shape_type_to_string(i),
+                               shape_type_to_string(j),
+                               st->calls, st->hits,
+                               bench_ticks_to_us(st->ticks, st->calls));
+                }
+        }
+}
+
+/*
+ * Same placements through both generic algorithms, hull pairs only. Each
+ * is also selected for the pair type in turn, and narrowphase_collide has
+ * to give exactly what asking for it by name does; so does mpr_intersect
+ * against MPR's hits. Returns how many placements break either.
+ */
+static uint32_t bench_algos(const struct shape *shapes, const int shape_cnt)
+{
+        enum narrowphase_algo algo_prev;
+        uint32_t fails;
+
+        fails = 0;
+        algo_prev = narrowphase_get_algo(SHAPE_HULL, SHAPE_HULL);
+        debugf("%s vs %s, hull pairs:\n",
+               narrowphase_algo_to_string(NARROWPHASE_ALGO_GJK_EPA),
+               narrowphase_algo_to_string(NARROWPHASE_ALGO_MPR));
+        debugf("%-5s %-5s %7s %7s %9s %9s %9s\n", "A", "B", "hits",
+               "agree", "gjk us", "mpr us", "depth err");
+        for (int i = 0; i < shape_cnt; ++i) {
+                for (int j = 0; j < shape_cnt; ++j) {
+                        uint32_t ticks[NARROWPHASE_ALGO_COUNT], hits, agree;
+                        struct shape a, b;
+                        float depth_err;
+
+                        a = shapes[i];
+                        b = shapes[j];
+                        if (a.type != SHAPE_HULL || b.type != SHAPE_HULL)
+                                continue;
+
+                        memset(ticks, 0, sizeof(ticks));
+                        hits = 0;
+                        agree = 0;
+                        depth_err = 0.f;
+                        for (int k = 0; k < BENCH_ITER_CNT; ++k) {
+                                struct contact c[NARROWPHASE_ALGO_COUNT];
+                                bool hit[NARROWPHASE_ALGO_COUNT];
+
+                                for (int l = 0; l < 3; ++l)
+                                        b.pos.v[l] = bench_randf() *
+                                                     BENCH_SPREAD;
+
+                                for (int l = 0; l < NARROWPHASE_ALGO_COUNT;
+                                     ++l) {
+                                        uint32_t start;
+
+                                        start = get_ticks();
+                                        hit[l] = narrowphase_collide_with(
+                                                c + l, &a, &b, l);
+                                        ticks[l] += TICKS_DISTANCE(
+                                                start, get_ticks());
+                                }
+
+                                for (int l = 0; l < NARROWPHASE_ALGO_COUNT;
+                                     ++l) {
+                                        struct contact c_sel;
+                                        bool hit_sel;
+
+                                        narrowphase_set_algo(SHAPE_HULL,
+                                                             SHAPE_HULL, l);
+                                        hit_sel = narrowphase_collide(
+                                                &c_sel, &a, &b);
+                                        fails += (narrowphase_get_algo(
+                                                  SHAPE_HULL, SHAPE_HULL) !=
+                                                  (enum narrowphase_algo)l);
+                                        fails += (hit_sel != hit[l] ||
+                                                  (hit_sel && c_sel.depth !=
+                                                   c[l].depth));
+                                }
+
+                                fails += (mpr_intersect(&a, &b) !=
+                                          hit[NARROWPHASE_ALGO_MPR]);
+
+                                hits += hit[NARROWPHASE_ALGO_GJK_EPA];
+                                agree += (hit[NARROWPHASE_ALGO_GJK_EPA] ==
+                                          hit[NARROWPHASE_ALGO_MPR]);
+                                if (hit[NARROWPHASE_ALGO_GJK_EPA] &&
+                                    hit[NARROWPHASE_ALGO_MPR])
+                                        depth_err += fabsf(
+                                                c[NARROWPHASE_ALGO_MPR].depth -
+                                                c[NARROWPHASE_ALGO_GJK_EPA]
+                                                .depth);
+                        }
+
+                        debugf("%-5d %-5d %7lu %7lu %9.2f %9.2f %9.4f\n",
+                               i, j, hits, agree,
+                               bench_ticks_to_us(
+                                        ticks[NARROWPHASE_ALGO_GJK_EPA],
+                                        BENCH_ITER_CNT),
+                               bench_ticks_to_us(ticks[NARROWPHASE_ALGO_MPR],
+                                                 BENCH_ITER_CNT),
+                               (hits) ? depth_err / hits : 0.f);
+                }
+        }
+
+        narrowphase_set_algo(SHAPE_HULL, SHAPE_HULL, algo_prev);
+
+        return fails;
+}
+
+/*
+ * Cost of turning one narrowphase contact into a manifold, per pair type
+ * that has faces: folding the point in incrementally vs clipping faces.
+ */
+static void bench_manifold(const struct shape *shapes, const int shape_cnt)
+{
+        debugf("Manifold build, face pairs:\n");
+        debugf("%-9s %-9s %7s %9s %9s %9s\n", "A", "B", "hits", "fold us",
+               "clip us", "clip pts");
+        for (int i = 0; i < shape_cnt; ++i) {
+                for (int j = 0; j < shape_cnt; ++j) {
+                        uint32_t ticks_fold, ticks_clip, hits, pts;
+                        struct shape a, b;
+
+                        a = shapes[i];
+                        b = shapes[j];
+                        if ((a.type != SHAPE_HULL && a.type != SHAPE_BOX) ||
+                            (b.type != SHAPE_HULL && b.type != SHAPE_BOX))
+                                continue;
+
+                        ticks_fold = 0;
+                        ticks_clip = 0;
+                        hits = 0;
+                        pts = 0;
+                        for (int k = 0; k < BENCH_ITER_CNT; ++k) {
+                                struct contact c, clipped[CLIP_VERT_MAX];
+                                struct manifold m;
+                                uint32_t start;
+                                int cnt;
+
+                                for (int l = 0; l < 3; ++l)
+                                        b.pos.v[l] = bench_randf() *
+                                                     BENCH_SPREAD;
+
+                                if (!narrowphase_collide(&c, &a, &b))
+                                        continue;
+
+                                ++hits;
+                                manifold_init(&m);
+                                start = get_ticks();
+                                manifold_update(&m, &c, &a, &b);
+                                ticks_fold += TICKS_DISTANCE(start,
+                                                             get_ticks());
+
+                                start = get_ticks();
+                                cnt = clip_contacts(clipped, CLIP_VERT_MAX,
+                                                    &c, &a, &b);
+                                manifold_set(&m, clipped, cnt, &a, &b);
+                                ticks_clip += TICKS_DISTANCE(start,
+                                                             get_ticks());
+                                pts += m.cnt;
+                        }
+
+                        debugf("%-9s %-9s %7lu %9.2f %9.2f %9.2f\n",
+                               shape_type_to_string(a.type),
+                               shape_type_to_string(b.type), hits,
+                               bench_ticks_to_us(ticks_fold, hits),
+                               bench_ticks_to_us(ticks_clip, hits),
+                               (hits) ? (float)pts / hits : 0.f);
+                }
+        }
+}
+
+/* Boxes in columns over a static floor, sized for BENCH_BODY_CNT. */
+static struct world bench_bodies_create(struct arena *ar)
+{
+        static const T3DVec3 floor_half = {{1000.f, 1000.f, .5f}};
+        static const T3DVec3 floor_pos = {{0.f, 0.f, -.5f}};
+        static const T3DVec3 box_half = {{.25f, .25f, .25f}};
+        struct world_config cfg;
+        struct world w;
+        struct shape s;
+        struct body b;
+        int side;
+
+        cfg = (struct world_config){
+                .body_cap = BENCH_BODY_CNT + 1,
+                .pair_cap = BENCH_BODY_CNT * 8,
+                .cache_cap = BENCH_BODY_CNT * 8,
+                .contact_cap = BENCH_BODY_CNT * 16
+        };
+        w = world_create(&cfg, ar);
+
+        s = shape_make_box(&floor_half, &floor_pos, NULL);
+        b = body_make(&s, 0.f);
+        world_add_body(&w, &b);
+
+        side = 1;
+        while (side * side * 4 < BENCH_BODY_CNT)
+                ++side;
+
+        for (int i = 0; i < BENCH_BODY_CNT; ++i) {
+                T3DVec3 pos;
+
+                pos.v[0] = (i % side) * .75f + bench_randf() * .05f;
+                pos.v[1] = ((i / side) % side) * .75f + bench_randf() * .05f;
+                pos.v[2] = .3f + (i / (side * side)) * .55f;
+                s = shape_make_box(&box_half, &pos, NULL);
+                b = body_make(&s, 1.f);
+                world_add_body(&w, &b);
+        }
+
+        return w;
+}
+
+/*
+ * Boxes dropped in columns onto a static floor, stepped at TICKRATE. Reports
+ * the cost per step, overall and over the second half once they've had time
+ * to settle, and how many have fallen asleep by the end.
+ */
+static void bench_bodies(void)
+{
+        struct arena ar;
+        struct world w;
+        uint32_t ticks, ticks_late, rows_max, asleep;
+
+        ar = arena_create(BENCH_BODY_ARENA_SIZE(BENCH_BODY_CNT));
+        w = bench_bodies_create(&ar);
+
+        ticks = 0;
+        ticks_late = 0;
+        rows_max = 0;
+        for (int i = 0; i < BENCH_BODY_STEP_CNT; ++i) {
+                uint32_t start, dur;
+
+                start = get_ticks();
+                world_step(&w, 1.f / TICKRATE);
+                dur = TICKS_DISTANCE(start, get_ticks());
+                ticks += dur;
+                if (i >= BENCH_BODY_STEP_CNT / 2)
+                        ticks_late += dur;
+
+                if (w.rows.cnt > rows_max)
+                        rows_max = w.rows.cnt;
+        }
+
+        asleep = 0;
+        for (int i = 1; i < w.body_cnt; ++i)
+                asleep += w.bodies[i].asleep;
+
+        debugf("Rigid bodies: %d boxes, %d steps\n", BENCH_BODY_CNT,
+               BENCH_BODY_STEP_CNT);
+        debugf("  %.1f us/step, %.1f settled, %lu rows max\n",
+               bench_ticks_to_us(ticks, BENCH_BODY_STEP_CNT),
+               bench_ticks_to_us(ticks_late, BENCH_BODY_STEP_CNT -
+                                 BENCH_BODY_STEP_CNT / 2), rows_max);
+        debugf("  %lu asleep, %lu dropped\n", asleep,
+               w.contacts.dropped + w.rows.dropped);
+
+        arena_destroy(&ar);
+}
+
+/* Returns how many scans over the cloud disagreed with the scalar one. */
+static uint32_t bench_support_cloud(const int label, const float *x,
+                                    const float *y, const float *z,
+                                    const uint32_t vert_cnt)
+{
+        T3DVec3 dirs[BENCH_ITER_CNT];
+        uint32_t cnt, fails, ref[BENCH_ITER_CNT];
+
+        cnt = COLLISION_SOA_PAD_CNT(vert_cnt);
+        for (int k = 0; k < BENCH_ITER_CNT; ++k) {
+                for (int l = 0; l < 3; ++l)
+                        dirs[k].v[l] = bench_randf();
+
+                ref[k] = max_dot_scalar(x, y, z, cnt, dirs + k);
+        }
+
+        fails = 0;
+        for (int j = 0; j <= (int)max_dot_get_impl(); ++j) {
+                uint32_t start, ticks, agree;
+
+                agree = 0;
+                start = get_ticks();
+                for (int k = 0; k < BENCH_ITER_CNT; ++k)
+                        agree += (max_dot_with(x, y, z, cnt, dirs + k, j) ==
+                                  ref[k]);
+
+                ticks = TICKS_DISTANCE(start, get_ticks());
+                fails += BENCH_ITER_CNT - agree;
+                debugf("%-5d %7lu %-8s %9.3f %7lu\n", label, vert_cnt,
+                       max_dot_impl_to_string(j),
+                       bench_ticks_to_us(ticks, BENCH_ITER_CNT), agree);
+        }
+
+        return fails;
+}
+
+/*
+ * Every max-dot kernel this build has over each mesh as a point cloud,
+ * then over a large random one listed twice, so every maximum is a tie
+ * the kernels have to break towards the lower index. Returns how many
+ * scans disagreed with the scalar reference.
+ */
+static uint32_t bench_support(const struct collision_hull **hulls,
+                              const int hull_cnt)
+{
+        static float x[BENCH_SUPPORT_CLOUD_CNT], y[BENCH_SUPPORT_CLOUD_CNT],
+                     z[BENCH_SUPPORT_CLOUD_CNT];
+        uint32_t fails;
+
+        fails = 0;
+        debugf("Support scan, best kernel %s:\n",
+               max_dot_impl_to_string(max_dot_get_impl()));
+        debugf("%-5s %7s %-8s %9s %7s\n", "mesh", "verts", "kernel",
+               "us/call", "agree");
+        for (int i = 0; i < hull_cnt; ++i)
+                if (hulls[i]->vert_cnt)
+                        fails += bench_support_cloud(i, hulls[i]->vx,
+                                                     hulls[i]->vy,
+                                                     hulls[i]->vz,
+                                                     hulls[i]->vert_cnt);
+
+        for (int i = 0; i < BENCH_SUPPORT_CLOUD_CNT / 2; ++i) {
+                x[i] = bench_randf();
+                y[i] = bench_randf();
+                z[i] = bench_randf();
+                x[i + BENCH_SUPPORT_CLOUD_CNT / 2] = x[i];
+                y[i + BENCH_SUPPORT_CLOUD_CNT / 2] = y[i];
+                z[i + BENCH_SUPPORT_CLOUD_CNT / 2] = z[i];
+        }
+
+        fails += bench_support_cloud(-1, x, y, z, BENCH_SUPPORT_CLOUD_CNT);
+
+        return fails;
+}
+
+/*
+ * Rounded shapes against every shape: the distance GJK finds has to be
+ * the bare core's less the margin, wherever the rounded one stays clear.
+ * Returns how many placements are off by more than BENCH_MARGIN_TOL.
+ */
+static uint32_t bench_margin(const struct shape *shapes, const int shape_cnt)
+{
+        uint32_t fails;
+
+        fails = 0;
+        debugf("Margin vs bare core, distance:\n");
+        debugf("%-5s %-5s %7s %9s\n", "A", "B", "clear", "dist err");
+        for (int i = 0; i < shape_cnt; ++i) {
+                for (int j = 0; j < shape_cnt; ++j) {
+                        struct shape a, bare, b;
+                        uint32_t clear;
+                        float dist_err;
+
+                        a = shapes[i];
+                        b = shapes[j];
+                        if (!a.margin)
+                                continue;
+
+                        bare = a;
+                        shape_set_margin(&bare, 0.f);
+                        clear = 0;
+                        dist_err = 0.f;
+                        for (int k = 0; k < BENCH_ITER_CNT; ++k) {
+                                struct gjk_result res, res_bare;
+                                float err;
+
+                                for (int l = 0; l < 3; ++l)
+                                        b.pos.v[l] = bench_randf() *
+                                                     BENCH_SPREAD;
+
+                                gjk_distance(&res, &a, &b);
+                                gjk_distance(&res_bare, &bare, &b);
+                                if (res_bare.distance <= a.margin +
+                                                         BENCH_MARGIN_TOL)
+                                        continue;
+
+                                err = fabsf(res.distance -
+                                            (res_bare.distance - a.margin));
+                                if (err > dist_err)
+                                        dist_err = err;
+
+                                fails += (res.intersecting ||
+                                          err > BENCH_MARGIN_TOL);
+                                ++clear;
+                        }
+
+                        debugf("%-5d %-5d %7lu %9.5f\n", i, j, clear,
+                               dist_err);
+                }
+        }
+
+        return fails;
+}
+
+/*
+ * The closed-form pairs with a margin on A, against GJK/EPA on the same
+ * placements. Hits only have to agree once either side is deeper than
+ * BENCH_MARGIN_TOL, grazing contacts can go either way.
+ */
+static uint32_t bench_margin_closed(const struct shape *shapes,
+                                    const int shape_cnt)
+{
+        uint32_t fails;
+
+        fails = 0;
+        debugf("Margin, closed form vs GJK+EPA:\n");
+        debugf("%-9s %-9s %7s %7s %9s %9s\n", "A", "B", "hits", "differ",
+               "depth err", "norm err");
+        for (int i = 0; i < shape_cnt; ++i) {
+                for (int j = 0; j < shape_cnt; ++j) {
+                        uint32_t hits, differ;
+                        struct shape a, b;
+                        float depth_err, norm_err;
+
+                        a = shapes[i];
+                        b = shapes[j];
+                        if (a.type < SHAPE_SPHERE || a.type > SHAPE_BOX ||
+                            b.type < SHAPE_SPHERE || b.type > SHAPE_BOX)
+                                continue;
+
+                        shape_set_margin(&a, BENCH_MARGIN);
+                        hits = 0;
+                        differ = 0;
+                        depth_err = 0.f;
+                        norm_err = 0.f;
+                        for (int k = 0; k < BENCH_ITER_CNT; ++k) {
+                                struct contact c, c_gjk;
+                                bool hit, hit_gjk;
+                                float err;
+
+                                for (int l = 0; l < 3; ++l)
+                                        b.pos.v[l] = bench_randf() *
+                                                     BENCH_SPREAD;
+
+                                hit = narrowphase_collide(&c, &a, &b);
+                                hit_gjk = narrowphase_collide_with(
+                                        &c_gjk, &a, &b,
+                                        NARROWPHASE_ALGO_GJK_EPA);
+                                hits += hit;
+                                if (hit != hit_gjk) {
+                                        ++differ;
+                                        fails += ((hit) ? c.depth :
+                                                  c_gjk.depth) >
+                                                 BENCH_MARGIN_TOL;
+                                        continue;
+                                }
+
+                                if (!hit)
+                                        continue;
+
+                                err = fabsf(c.depth - c_gjk.depth);
+                                if (err > depth_err)
+                                        depth_err = err;
+
+                                fails += (err > BENCH_MARGIN_TOL);
+
+                                /* Near-coincident centres have no normal */
+                                if (c.depth < BENCH_MARGIN_TOL)
+                                        continue;
+
+                                err = 1.f - t3d_vec3_dot(&c.normal,
+                                                         &c_gjk.normal);
+                                if (err > norm_err)
+                                        norm_err = err;
+
+                                fails += (err > BENCH_MARGIN_TOL);
+                        }
+
+                        debugf("%-9s %-9s %7lu %7lu %9.5f %9.5f\n",
+                               shape_type_to_string(a.type),
+                               shape_type_to_string(b.type), hits, differ,
+                               depth_err, norm_err);
+                }
+        }
+
+        return fails;
+}
+
+#ifdef COLLISION_FIXED_POINT
+/*
+ * Differential check of the integer kernel against the float one on the
+ * same placements, with the cycle cost of each. Returns how many
+ * placements they disagree on by more than BENCH_FIXED_DIST_TOL, which
+ * is well past what quantising to 16.16 can account for, in distance or
+ * in whether the bounds overlap. Quantised bounds that miss while GJK
+ * finds a hit fail too, the narrowphase trusts them to reject.
+ */
+static uint32_t bench_fixed(const struct shape *shapes, const int shape_cnt)
+{
+        uint32_t fails;
+
+        fails = 0;
+        debugf("GJK float vs 16.16, hull pairs:\n");
+        debugf("%-5s %-5s %7s %7s %7s %9s %9s %9s\n", "A", "B", "hits",
+               "differ", "box dif", "float us", "fixed us", "dist err");
+        for (int i = 0; i < shape_cnt; ++i) {
+                for (int j = 0; j < shape_cnt; ++j) {
+                        uint32_t ticks_flt, ticks_fx, hits, differ, box_differ;
+                        struct shape a, b;
+                        float dist_err;
+
+                        a = shapes[i];
+                        b = shapes[j];
+                        if (a.type != SHAPE_HULL || b.type != SHAPE_HULL ||
+                            a.margin || b.margin)
+                                continue;
+
+                        ticks_flt = 0;
+                        ticks_fx = 0;
+                        hits = 0;
+                        differ = 0;
+                        box_differ = 0;
+                        dist_err = 0.f;
+                        for (int k = 0; k < BENCH_ITER_CNT; ++k) {
+                                struct gjk_fixed_result fres;
+                                struct gjk_simplex sp;
+                                struct gjk_result res;
+                                struct fx_vec3 pos_a, pos_b;
+                                T3DVec3 min_a, max_a, min_b, max_b;
+                                uint32_t start;
+                                float err, gap;
+                                bool box_fx;
+
+                                for (int l = 0; l < 3; ++l) {
+                                        b.pos.v[l] = bench_randf() *
+                                                     BENCH_SPREAD;
+                                        pos_a.v[l] = FX_FROM_FLOAT(
+                                                a.pos.v[l]);
+                                        pos_b.v[l] = FX_FROM_FLOAT(
+                                                b.pos.v[l]);
+                                }
+
+                                start = get_ticks();
+                                gjk_distance_simplex(&res, &sp, &a, &b);
+                                ticks_flt += TICKS_DISTANCE(start,
+                                                            get_ticks());
+
+                                start = get_ticks();
+                                gjk_fixed_distance(&fres, a.hull, &pos_a,
+                                                   b.hull, &pos_b);
+                                ticks_fx += TICKS_DISTANCE(start,
+                                                           get_ticks());
+
+                                hits += res.intersecting;
+                                differ += (res.intersecting !=
+                                           fres.intersecting);
+                                err = fabsf(FX_TO_FLOAT(fres.distance) -
+                                            res.distance);
+                                if (err > dist_err)
+                                        dist_err = err;
+
+                                /* Touching is allowed to go either way. */
+                                fails += (err > BENCH_FIXED_DIST_TOL);
+
+                                /* Widest gap between the float bounds */
+                                shape_get_bounds(&min_a, &max_a, &a);
+                                shape_get_bounds(&min_b, &max_b, &b);
+                                gap = -INFINITY;
+                                for (int l = 0; l < 3; ++l)
+                                        gap = fmaxf(gap, fmaxf(
+                                                min_a.v[l] - max_b.v[l],
+                                                min_b.v[l] - max_a.v[l]));
+
+                                box_fx = fx_aabb_overlap(&a.hull->bounds_fx,
+                                                         &pos_a,
+                                                         &b.hull->bounds_fx,
+                                                         &pos_b);
+                                box_differ += (box_fx != (gap <= 0.f));
+                                fails += (box_fx != (gap <= 0.f) &&
+                                          fabsf(gap) > BENCH_FIXED_DIST_TOL);
+                                fails += (!box_fx && res.intersecting);
+                        }
+
+                        debugf("%-5d %-5d %7lu %7lu %7lu %9.2f %9.2f "
+                               "%9.5f\n", i, j, hits, differ, box_differ,
+                               bench_ticks_to_us(ticks_flt, BENCH_ITER_CNT),
+                               bench_ticks_to_us(ticks_fx, BENCH_ITER_CNT),
+                               dist_err);
+                }
+        }
+
+        return fails;
+}
+#endif
+
+#ifdef COLLISION_THREADS
+/* FNV-1a over where every body ended up, to compare runs bit for bit. */
+static uint32_t bench_world_hash(const struct world *w)
+{
+        uint32_t h;
+
+        h = 2166136261u;
+        for (uint16_t i = 0; i < w->body_cnt; ++i) {
+                const struct body *b;
+                const uint8_t *p;
+
+                b = w->bodies + i;
+                p = (const uint8_t *)&b->pos;
+                for (size_t j = 0; j < sizeof(b->pos); ++j)
+                        h = (h ^ p[j]) * 16777619u;
+
+                p = (const uint8_t *)b->axes;
+                for (size_t j = 0; j < sizeof(b->axes); ++j)
+                        h = (h ^ p[j]) * 16777619u;
+        }
+
+        return h;
+}
+
+static void bench_workers_visit(void *arg, const uint32_t first,
+                                const uint32_t cnt)
+{
+        uint8_t *visits;
+
+        visits = arg;
+        for (uint32_t i = first; i < first + cnt; ++i)
+                ++visits[i];
+}
+
+/*
+ * Runs the pool over item counts that don't split evenly into chunks or
+ * threads, and returns how many runs missed an item or ran one twice.
+ */
+static uint32_t bench_workers(void)
+{
+        static const uint32_t item_cnts[] = {0, 1, 17, 1000, 4099};
+        static uint8_t visits[4099];
+        uint32_t fails;
+        struct workers wk;
+
+        if (!workers_start(&wk, WORKERS_MAX)) {
+                debugf("Worker pool: failed to start\n");
+                return 1;
+        }
+
+        fails = 0;
+        for (size_t i = 0; i < sizeof(item_cnts) / sizeof(*item_cnts);
+             ++i) {
+                for (uint32_t chunk = 1; chunk <= 64; chunk *= 4) {
+                        memset(visits, 0, sizeof(visits));
+                        workers_run(&wk, bench_workers_visit, visits,
+                                    item_cnts[i], chunk);
+                        for (uint32_t j = 0; j < item_cnts[i]; ++j) {
+                                if (visits[j] != 1) {
+                                        ++fails;
+                                        break;
+                                }
+                        }
+                }
+        }
+
+        debugf("Worker pool: %d threads, %lu runs wrong\n", wk.cnt, fails);
+        workers_stop(&wk);
+
+        return fails;
+}
+
+/*
+ * The body bench again with the narrowphase spread over 1, 2, 4 and 8
+ * threads. Every run has to land on the same state as the single threaded
+ * one, anything else means the merge isn't deterministic. Returns how many
+ * runs didn't.
+ */
+static uint32_t bench_threads(void)
+{
+        static const int thread_cnts[] = {1, 2, 4, 8};
+        uint32_t seed, hash_ref, ticks_ref, fails;
+
+        debugf("Threaded narrowphase: %d boxes, %d steps\n", BENCH_BODY_CNT,
+               BENCH_BODY_STEP_CNT);
+        seed = bench_rand_state;
+        hash_ref = 0;
+        ticks_ref = 0;
+        fails = 0;
+        for (size_t i = 0; i < sizeof(thread_cnts) / sizeof(*thread_cnts);
+             ++i) {
+                struct workers wk;
+                struct arena ar;
+                struct world w;
+                uint32_t ticks, hash;
+
+                if (!workers_start(&wk, thread_cnts[i])) {
+                        debugf("  %d threads: failed to start\n",
+                               thread_cnts[i]);
+                        ++fails;
+                        continue;
+                }
+
+                bench_rand_state = seed;
+                ar = arena_create(BENCH_BODY_ARENA_SIZE(BENCH_BODY_CNT));
+                w = bench_bodies_create(&ar);
+                world_set_workers(&w, &wk);
+
+                ticks = 0;
+                for (int j = 0; j < BENCH_BODY_STEP_CNT; ++j) {
+                        uint32_t start;
+
+                        start = get_ticks();
+                        world_step(&w, 1.f / TICKRATE);
+                        ticks += TICKS_DISTANCE(start, get_ticks());
+                }
+
+                hash = bench_world_hash(&w);
+                if (!i) {
+                        hash_ref = hash;
+                        ticks_ref = ticks;
+                }
+
+                fails += (hash != hash_ref);
+
+                debugf("  %d threads: %.1f us/step, x%.2f, %s\n",
+                       wk.cnt, bench_ticks_to_us(ticks, BENCH_BODY_STEP_CNT),
+                       (ticks) ? (float)ticks_ref / ticks : 0.f,
+                       (hash == hash_ref) ? "same state" : "DIFFERS");
+
+                arena_destroy(&ar);
+                workers_stop(&wk);
+        }
+
+        return fails;
+}
+#endif
+
+/* Returns how many of the self-checks failed, for host runs to act on. */
+uint32_t bench_run(const struct collision_hull **hulls, const int hull_cnt)
+{
+        struct shape shapes[BENCH_SHAPE_MAX];
+        uint32_t fails;
+        int shape_cnt;
+
+        bench_rand_state = 1;
+        shape_cnt = bench_make_shapes(shapes, hulls, hull_cnt);
+
+        debugf("=== BENCHMARK (%d iterations per pair) ===\n",
+               BENCH_ITER_CNT);
+        bench_narrowphase(shapes, shape_cnt);
+        fails = bench_algos(shapes, shape_cnt);
+        bench_manifold(shapes, shape_cnt);
+        fails += bench_support(hulls, hull_cnt);
+        fails += bench_margin(shapes, shape_cnt);
+        fails += bench_margin_closed(shapes, shape_cnt);
+        bench_bodies();
+#ifdef COLLISION_THREADS
+        fails += bench_workers();
+        fails += bench_threads();
+#endif
+#ifdef COLLISION_FIXED_POINT
+        fails += bench_fixed(shapes, shape_cnt);
+#endif
+        debugf("=== BENCHMARK DONE (%lu failed) ===\n", fails);
+
+        return fails;
+}
+
+#endif /* DEBUG */
@@ -0,0 +1,24 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "collision.h"
+
+#define BENCH_ITER_CNT 256
+#define BENCH_SPREAD 1.5f
+#define BENCH_SUPPORT_CLOUD_CNT 1024 /* A multiple of COLLISION_SOA_PAD */
+#define BENCH_FIXED_DIST_TOL .001f
+#define BENCH_MARGIN .05f
+#define BENCH_MARGIN_TOL .01f
+#define BENCH_HULL_MAX 8 /* Most hulls handed over from the meshes */
+
+/* Rigid body stacking, override for host runs with thousands of bodies. */
+#ifndef BENCH_BODY_CNT
+#define BENCH_BODY_CNT 32
+#endif
+#define BENCH_BODY_STEP_CNT 60
+#define BENCH_BODY_ARENA_SIZE(n) (8192 + (n) * 6144)
+
+uint32_t bench_run(const struct collision_hull **hulls,
+                   const int hull_cnt);
+
+#endif /* BENCH_H */
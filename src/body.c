@@ -0,0 +1,299 @@
+#include <libdragon.h>
+
+#include "body.h"
+
+/*
+ * Volume, centroid and second moments about that centroid, from the
+ * integrals over the tetrahedra each triangle forms with the shape origin,
+ * for unit density. Only the diagonal is kept, which is exact for
+ * symmetric hulls and close enough for the rest.
+ */
+static float body_hull_moments(T3DVec3 *centre, T3DVec3 *moments,
+                               const struct collision_hull *h)
+{
+        T3DVec3 first;
+        float vol;
+
+        vol = 0.f;
+        first = (T3DVec3){{0.f, 0.f, 0.f}};
+        *moments = (T3DVec3){{0.f, 0.f, 0.f}};
+        for (uint32_t i = 0; i < h->tri_cnt; ++i) {
+                const T3DVec3 *p;
+                T3DVec3 bc;
+                float det;
+
+                p = h->tris[i].pos;
+                t3d_vec3_cross(&bc, p + 1, p + 2);
+                det = t3d_vec3_dot(p + 0, &bc);
+                vol += det / 6.f;
+                for (int k = 0; k < 3; ++k) {
+                        float sum, sum2;
+
+                        sum = p[0].v[k] + p[1].v[k] + p[2].v[k];
+                        sum2 = p[0].v[k] * p[0].v[k] +
+                               p[1].v[k] * p[1].v[k] +
+                               p[2].v[k] * p[2].v[k];
+                        first.v[k] += det / 24.f * sum;
+                        moments->v[k] += det / 120.f * (sum2 + sum * sum);
+                }
+        }
+
+        /* Inward winding flips every sign at once. */
+        if (vol < 0.f) {
+                vol = -vol;
+                t3d_vec3_scale(&first, &first, -1.f);
+                t3d_vec3_scale(moments, moments, -1.f);
+        }
+
+        *centre = (T3DVec3){{0.f, 0.f, 0.f}};
+        if (vol <= 0.f)
+                return vol;
+
+        /* Parallel axis, from the origin over to the centroid. */
+        t3d_vec3_scale(centre, &first, 1.f / vol);
+        for (int k = 0; k < 3; ++k)
+                moments->v[k] -= vol * centre->v[k] * centre->v[k];
+
+        return vol;
+}
+
+/* Principal moments of inertia, from second moments per unit mass. */
+static void body_inertia_from_moments(T3DVec3 *out, const T3DVec3 *m,
+                                      const float mass)
+{
+        out->v[0] = mass * (m->v[1] + m->v[2]);
+        out->v[1] = mass * (m->v[0] + m->v[2]);
+        out->v[2] = mass * (m->v[0] + m->v[1]);
+}
+
+/* Inertia about `com`, the centre of mass in the shape's local space. */
+static void body_get_inertia(T3DVec3 *out, T3DVec3 *com,
+                             const struct shape *s, const float mass)
+{
+        T3DVec3 m;
+        float r, h, vol;
+
+        r = s->margin;
+        *com = (T3DVec3){{0.f, 0.f, 0.f}};
+        switch (s->type) {
+                case SHAPE_HULL:
+                        vol = body_hull_moments(com, &m, s->hull);
+                        if (vol <= 0.f) {
+                                *out = (T3DVec3){{0.f, 0.f, 0.f}};
+                                return;
+                        }
+
+                        t3d_vec3_scale(&m, &m, 1.f / vol);
+                        break;
+
+                case SHAPE_SPHERE:
+                        r += s->sphere.radius;
+                        m = (T3DVec3){{r * r / 5.f, r * r / 5.f,
+                                       r * r / 5.f}};
+                        break;
+
+                case SHAPE_BOX:
+                        for (int i = 0; i < 3; ++i) {
+                                h = s->box.half_extents.v[i] + r;
+                                m.v[i] = h * h / 3.f;
+                        }
+
+                        break;
+
+                /* Round ends and tapers are close enough to a cylinder. */
+                case SHAPE_CAPSULE:
+                case SHAPE_CYLINDER:
+                case SHAPE_CONE:
+                        r += (s->type == SHAPE_CAPSULE) ? s->capsule.radius :
+                             s->cylinder.radius;
+                        h = (s->type == SHAPE_CAPSULE) ?
+                            s->capsule.half_height + s->capsule.radius :
+                            s->cylinder.half_height;
+                        m = (T3DVec3){{r * r / 4.f, r * r / 4.f,
+                                       h * h / 3.f}};
+                        break;
+
+                default:
+                        *out = (T3DVec3){{0.f, 0.f, 0.f}};
+                        return;
+        }
+
+        body_inertia_from_moments(out, &m, mass);
+}
+
+/* `mass` of zero or less makes it static. */
+struct body body_make(const struct shape *s, const float mass)
+{
+        struct body b;
+        T3DVec3 inertia;
+
+        b.shape = *s;
+        b.pos = s->pos;
+        if (s->axes) {
+                for (int i = 0; i < 3; ++i)
+                        b.axes[i] = s->axes[i];
+        } else {
+                b.axes[0] = (T3DVec3){{1.f, 0.f, 0.f}};
+                b.axes[1] = (T3DVec3){{0.f, 1.f, 0.f}};
+                b.axes[2] = (T3DVec3){{0.f, 0.f, 1.f}};
+        }
+
+        b.vel = (T3DVec3){{0.f, 0.f, 0.f}};
+        b.ang_vel = (T3DVec3){{0.f, 0.f, 0.f}};
+        b.friction = BODY_FRICTION_DEFAULT;
+        b.restitution = 0.f;
+        b.sleep_time = 0.f;
+        b.asleep = false;
+        b.moved = false;
+        b.island = 0;
+        b.inv_mass = 0.f;
+        b.inv_inertia = (T3DVec3){{0.f, 0.f, 0.f}};
+        b.com = (T3DVec3){{0.f, 0.f, 0.f}};
+        if (mass <= 0.f)
+                return b;
+
+        b.inv_mass = 1.f / mass;
+        body_get_inertia(&inertia, &b.com, s, mass);
+        for (int i = 0; i < 3; ++i)
+                b.inv_inertia.v[i] = (inertia.v[i] > 0.f) ?
+                                     1.f / inertia.v[i] : 0.f;
+
+        return b;
+}
+
+/* Only valid while `b` stays put, the axes point back into it. */
+struct shape body_get_shape(const struct body *b)
+{
+        struct shape s;
+
+        s = b->shape;
+        s.pos = b->pos;
+        s.axes = b->axes;
+
+        return s;
+}
+
+/* Centre of mass in world space, what the body turns about. */
+void body_get_centre(T3DVec3 *out, const struct body *b)
+{
+        T3DVec3 axis;
+
+        *out = b->pos;
+        for (int i = 0; i < 3; ++i) {
+                t3d_vec3_scale(&axis, b->axes + i, b->com.v[i]);
+                t3d_vec3_add(out, out, &axis);
+        }
+}
+
+/* World space inverse inertia times `v`: R * diag * R^T * v. */
+void body_inv_inertia_mul(T3DVec3 *out, const struct body *b,
+                          const T3DVec3 *v)
+{
+        T3DVec3 axis;
+
+        *out = (T3DVec3){{0.f, 0.f, 0.f}};
+        for (int i = 0; i < 3; ++i) {
+                t3d_vec3_scale(&axis, b->axes + i, b->inv_inertia.v[i] *
+                               t3d_vec3_dot(v, b->axes + i));
+                t3d_vec3_add(out, out, &axis);
+        }
+}
+
+/* `r` is from the centre of mass to where the impulse acts. */
+void body_apply_impulse(struct body *b, const T3DVec3 *impulse,
+                        const T3DVec3 *r)
+{
+        T3DVec3 tmp, dw;
+
+        t3d_vec3_scale(&tmp, impulse, b->inv_mass);
+        t3d_vec3_add(&b->vel, &b->vel, &tmp);
+        t3d_vec3_cross(&tmp, r, impulse);
+        body_inv_inertia_mul(&dw, b, &tmp);
+        t3d_vec3_add(&b->ang_vel, &b->ang_vel, &dw);
+}
+
+void body_get_point_vel(T3DVec3 *out, const struct body *b,
+                        const T3DVec3 *r)
+{
+        t3d_vec3_cross(out, &b->ang_vel, r);
+        t3d_vec3_add(out, out, &b->vel);
+}
+
+void body_integrate_velocity(struct body *b, const float dt)
+{
+        if (!b->inv_mass || b->asleep)
+                return;
+
+        b->vel.v[2] += BODY_GRAVITY * dt;
+        t3d_vec3_scale(&b->vel, &b->vel, 1.f - BODY_LINEAR_DAMPING * dt);
+        t3d_vec3_scale(&b->ang_vel, &b->ang_vel,
+                       1.f - BODY_ANGULAR_DAMPING * dt);
+}
+
+/*
+ * Moves the centre of mass and rotates the axes about it by the angular
+ * velocity, re-orthonormalises, then places the origin back around it.
+ */
+void body_integrate_position(struct body *b, const float dt)
+{
+        T3DVec3 tmp, centre;
+
+        if (!b->inv_mass || b->asleep)
+                return;
+
+        body_get_centre(&centre, b);
+        t3d_vec3_scale(&tmp, &b->vel, dt);
+        t3d_vec3_add(&centre, &centre, &tmp);
+        for (int i = 0; i < 3; ++i) {
+                t3d_vec3_cross(&tmp, &b->ang_vel, b->axes + i);
+                t3d_vec3_scale(&tmp, &tmp, dt);
+                t3d_vec3_add(b->axes + i, b->axes + i, &tmp);
+        }
+
+        t3d_vec3_norm(b->axes + 0);
+        t3d_vec3_scale(&tmp, b->axes + 0,
+                       t3d_vec3_dot(b->axes + 0, b->axes + 1));
+        t3d_vec3_diff(b->axes + 1, b->axes + 1, &tmp);
+        t3d_vec3_norm(b->axes + 1);
+        t3d_vec3_cross(b->axes + 2, b->axes + 0, b->axes + 1);
+
+        b->pos = centre;
+        for (int i = 0; i < 3; ++i) {
+                t3d_vec3_scale(&tmp, b->axes + i, b->com.v[i]);
+                t3d_vec3_diff(&b->pos, &b->pos, &tmp);
+        }
+}
+
+/* Counts up while the body stays slow, any real motion starts it over. */
+void body_update_sleep_time(struct body *b, const float dt)
+{
+        if (t3d_vec3_len2(&b->vel) > BODY_SLEEP_LIN_VEL * BODY_SLEEP_LIN_VEL ||
+            t3d_vec3_len2(&b->ang_vel) >
+            BODY_SLEEP_ANG_VEL * BODY_SLEEP_ANG_VEL) {
+                b->sleep_time = 0.f;
+                return;
+        }
+
+        b->sleep_time += dt;
+}
+
+/* Leftover drift is dropped so it wakes up exactly where it stopped. */
+void body_sleep(struct body *b, const uint32_t island)
+{
+        b->asleep = true;
+        b->island = island;
+        b->vel = (T3DVec3){{0.f, 0.f, 0.f}};
+        b->ang_vel = (T3DVec3){{0.f, 0.f, 0.f}};
+}
+
+void body_wake(struct body *b)
+{
+        b->asleep = false;
+        b->sleep_time = 0.f;
+}
+
+/* Whether it can disturb anything this step. */
+bool body_is_active(const struct body *b)
+{
+        return (b->inv_mass && !b->asleep) || b->moved;
+}
@@ -0,0 +1,52 @@
+#ifndef BODY_H
+#define BODY_H
+
+#include "shape.h"
+
+#define BODY_GRAVITY -9.81f /* Along Z */
+#define BODY_LINEAR_DAMPING .01f /* Fraction of velocity lost per second */
+#define BODY_ANGULAR_DAMPING .05f
+#define BODY_FRICTION_DEFAULT .5f
+#define BODY_SLEEP_LIN_VEL .05f /* Slower than these counts as at rest */
+#define BODY_SLEEP_ANG_VEL .1f
+#define BODY_SLEEP_TIME .5f /* Seconds at rest before it may sleep */
+
+/*
+ * A shape plus motion. Orientation is kept as the local axes in world
+ * space, which is what shapes already take. Zero inverse mass makes a body
+ * static or kinematic: it moves only when its position is set directly.
+ */
+struct body {
+        struct shape shape; /* Position and axes are the body's, not these */
+        T3DVec3 pos;
+        T3DVec3 axes[3];
+        T3DVec3 vel;
+        T3DVec3 ang_vel;
+        float inv_mass;
+        T3DVec3 inv_inertia; /* Diagonal, about the local axes */
+        T3DVec3 com; /* Centre of mass, in local space */
+        float friction;
+        float restitution;
+        float sleep_time; /* How long it has been at rest */
+        bool asleep;
+        bool moved; /* Position set directly since the last step */
+        uint32_t island; /* Id of the island it fell asleep with */
+};
+
+struct body body_make(const struct shape *s, const float mass);
+struct shape body_get_shape(const struct body *b);
+void body_get_centre(T3DVec3 *out, const struct body *b);
+void body_inv_inertia_mul(T3DVec3 *out, const struct body *b,
+                          const T3DVec3 *v);
+void body_apply_impulse(struct body *b, const T3DVec3 *impulse,
+                        const T3DVec3 *r);
+void body_get_point_vel(T3DVec3 *out, const struct body *b,
+                        const T3DVec3 *r);
+void body_integrate_velocity(struct body *b, const float dt);
+void body_integrate_position(struct body *b, const float dt);
+void body_update_sleep_time(struct body *b, const float dt);
+void body_sleep(struct body *b, const uint32_t island);
+void body_wake(struct body *b);
+bool body_is_active(const struct body *b);
+
+#endif /* BODY_H */
@@ -0,0 +1,74 @@
+#include <libdragon.h>
+
+#include "broadphase.h"
+
+struct broadphase broadphase_create(const uint16_t cap, struct arena *ar)
+{
+        struct broadphase bp;
+
+        bp.order = arena_alloc(ar, sizeof(*bp.order) * cap);
+        bp.cnt = 0;
+        bp.cap = cap;
+
+        return bp;
+}
+
+static bool broadphase_overlap(const T3DVec3 *min_a, const T3DVec3 *max_a,
+                               const T3DVec3 *min_b, const T3DVec3 *max_b)
+{
+        for (int i = 1; i < 3; ++i)
+                if (min_a->v[i] > max_b->v[i] || max_a->v[i] < min_b->v[i])
+                        return false;
+
+        return true;
+}
+
+/* Overlapping pairs are appended to `pairs`, which the caller clears. */
+void broadphase_update(struct broadphase *bp, struct pool *pairs,
+                       const T3DVec3 *mins, const T3DVec3 *maxs,
+                       const uint16_t cnt)
+{
+        if (cnt != bp->cnt) {
+                bp->cnt = (cnt < bp->cap) ? cnt : bp->cap;
+                for (uint16_t i = 0; i < bp->cnt; ++i)
+                        bp->order[i] = i;
+        }
+
+        for (uint16_t i = 1; i < bp->cnt; ++i) {
+                uint16_t id;
+                int j;
+
+                id = bp->order[i];
+                for (j = i - 1; j >= 0 &&
+                     mins[bp->order[j]].v[0] > mins[id].v[0]; --j)
+                        bp->order[j + 1] = bp->order[j];
+
+                bp->order[j + 1] = id;
+        }
+
+        for (uint16_t i = 0; i < bp->cnt; ++i) {
+                uint16_t a;
+
+                a = bp->order[i];
+                for (uint16_t j = i + 1; j < bp->cnt; ++j) {
+                        struct broadphase_pair *p;
+                        uint16_t b;
+
+                        b = bp->order[j];
+                        if (mins[b].v[0] > maxs[a].v[0])
+                                break;
+
+                        if (!broadphase_overlap(mins + a, maxs + a,
+                                                mins + b, maxs + b))
+                                continue;
+
+                        /* Keep sweeping so `dropped` says how many. */
+                        p = pool_push(pairs);
+                        if (!p)
+                                continue;
+
+                        p->a = (a < b) ? a : b;
+                        p->b = (a < b) ? b : a;
+                }
+        }
+}
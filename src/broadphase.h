@@ -0,0 +1,28 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <t3d/t3dmath.h>
+
+#include "pool.h"
+
+struct broadphase_pair {
+        uint16_t a; /* Always less than `b` */
+        uint16_t b;
+};
+
+/*
+ * Sort and sweep along X. The order is kept between updates, so the
+ * insertion sort only has to fix up what moved.
+ */
+struct broadphase {
+        uint16_t *order;
+        uint16_t cnt;
+        uint16_t cap;
+};
+
+struct broadphase broadphase_create(const uint16_t cap, struct arena *ar);
+void broadphase_update(struct broadphase *bp, struct pool *pairs,
+                       const T3DVec3 *mins, const T3DVec3 *maxs,
+                       const uint16_t cnt);
+
+#endif /* BROADPHASE_H */
@@ -0,0 +1,117 @@
+#include <libdragon.h>
+
+#include "clip.h"
+
+/* Sutherland-Hodgman against one plane, keeping the side `n` points away. */
+static int clip_polygon_plane(T3DVec3 *out, const T3DVec3 *in,
+                              const int cnt, const T3DVec3 *n,
+                              const float d)
+{
+        int out_cnt;
+
+        out_cnt = 0;
+        for (int i = 0; i < cnt; ++i) {
+                const T3DVec3 *p, *q;
+                float dp, dq;
+
+                p = in + i;
+                q = in + (i + 1) % cnt;
+                dp = t3d_vec3_dot(n, p) - d;
+                dq = t3d_vec3_dot(n, q) - d;
+                if (dp <= 0.f && out_cnt < CLIP_VERT_MAX)
+                        out[out_cnt++] = *p;
+
+                if ((dp < 0.f) != (dq < 0.f) && out_cnt < CLIP_VERT_MAX) {
+                        T3DVec3 pq;
+
+                        t3d_vec3_diff(&pq, q, p);
+                        t3d_vec3_scale(&pq, &pq, dp / (dp - dq));
+                        t3d_vec3_add(out + out_cnt++, p, &pq);
+                }
+        }
+
+        return out_cnt;
+}
+
+/*
+ * Full contact patch in one go: the face best aligned with the contact
+ * normal is the reference, the most opposed face on the other shape is
+ * clipped to its side planes, and whatever ends up below the reference
+ * face becomes a contact. Returns 0 when either shape has no faces or
+ * a margin, leaving the caller with the single narrowphase point.
+ */
+int clip_contacts(struct contact *out, const int out_max,
+                  const struct contact *c, const struct shape *a,
+                  const struct shape *b)
+{
+        T3DVec3 ref[CLIP_VERT_MAX], inc[2][CLIP_VERT_MAX];
+        T3DVec3 n_ref, n_inc, n_a, n_b, dir;
+        const struct shape *s_ref, *s_inc;
+        int ref_cnt, inc_cnt, out_cnt, cur;
+        float d_ref;
+        bool ref_is_a;
+
+        if (a->margin || b->margin)
+                return 0;
+
+        ref_cnt = shape_get_face(ref, &n_a, CLIP_VERT_MAX, a, &c->normal);
+        t3d_vec3_scale(&dir, &c->normal, -1.f);
+        inc_cnt = shape_get_face(inc[0], &n_b, CLIP_VERT_MAX, b, &dir);
+        if (!ref_cnt || !inc_cnt)
+                return 0;
+
+        /* Favour A slightly so near ties don't flip from tick to tick. */
+        ref_is_a = (t3d_vec3_dot(&n_a, &c->normal) + 1e-3f >=
+                    t3d_vec3_dot(&n_b, &dir));
+        s_ref = (ref_is_a) ? a : b;
+        s_inc = (ref_is_a) ? b : a;
+        n_ref = (ref_is_a) ? n_a : n_b;
+        if (!ref_is_a)
+                ref_cnt = shape_get_face(ref, &n_ref, CLIP_VERT_MAX, s_ref,
+                                         &dir);
+
+        t3d_vec3_scale(&dir, &n_ref, -1.f);
+        inc_cnt = shape_get_face(inc[0], &n_inc, CLIP_VERT_MAX, s_inc, &dir);
+        if (!ref_cnt || !inc_cnt)
+                return 0;
+
+        cur = 0;
+        for (int i = 0; i < ref_cnt && inc_cnt; ++i) {
+                T3DVec3 edge, side;
+
+                t3d_vec3_diff(&edge, ref + (i + 1) % ref_cnt, ref + i);
+                t3d_vec3_cross(&side, &edge, &n_ref);
+                inc_cnt = clip_polygon_plane(inc[cur ^ 1], inc[cur], inc_cnt,
+                                             &side,
+                                             t3d_vec3_dot(&side, ref + i));
+                cur ^= 1;
+        }
+
+        d_ref = t3d_vec3_dot(&n_ref, ref + 0);
+        out_cnt = 0;
+        for (int i = 0; i < inc_cnt && out_cnt < out_max; ++i) {
+                struct contact *o;
+                T3DVec3 on_ref;
+                float depth;
+
+                depth = d_ref - t3d_vec3_dot(&n_ref, inc[cur] + i);
+                if (depth < 0.f)
+                        continue;
+
+                o = out + out_cnt++;
+                t3d_vec3_scale(&on_ref, &n_ref, depth);
+                t3d_vec3_add(&on_ref, inc[cur] + i, &on_ref);
+                o->depth = depth;
+                if (ref_is_a) {
+                        o->point_a = on_ref;
+                        o->point_b = inc[cur][i];
+                        o->normal = n_ref;
+                } else {
+                        o->point_a = inc[cur][i];
+                        o->point_b = on_ref;
+                        t3d_vec3_scale(&o->normal, &n_ref, -1.f);
+                }
+        }
+
+        return out_cnt;
+}
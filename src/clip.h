@@ -0,0 +1,13 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include "contact.h"
+#include "shape.h"
+
+#define CLIP_VERT_MAX 32
+
+int clip_contacts(struct contact *out, const int out_max,
+                  const struct contact *c, const struct shape *a,
+                  const struct shape *b);
+
+#endif /* CLIP_H */
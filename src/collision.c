@@ -0,0 +1,458 @@
+#include <libdragon.h>
+
+#include "collision.h"
+#include "max_dot.h"
+
+/* Load-time scratch for building hulls, sized for the largest one. */
+struct collision_scratch {
+        uint32_t mask;
+        uint32_t *heads; /* First vertex in each bucket */
+        uint32_t *next; /* Per vertex, the rest of its bucket, then stamps */
+        uint32_t *corners; /* Per triangle corner, the vertex it became */
+        uint32_t *tri_faces; /* Per triangle, its face or UINT32_MAX */
+        uint32_t *tri_order; /* Triangles grouped by face */
+        struct collision_face *planes; /* Faces as they're found */
+};
+
+/* Everything comes from `scratch`, which the caller winds back after. */
+static void collision_scratch_create(struct collision_scratch *w,
+                                     const uint32_t corner_max,
+                                     struct arena *scratch)
+{
+        w->mask = 1;
+        while (w->mask < corner_max * 2)
+                w->mask <<= 1;
+
+        w->heads = arena_alloc(scratch, sizeof(*w->heads) * w->mask);
+        w->next = arena_alloc(scratch, sizeof(*w->next) * corner_max);
+        w->corners = arena_alloc(scratch, sizeof(*w->corners) * corner_max);
+        w->tri_faces = arena_alloc(scratch, sizeof(*w->tri_faces) *
+                                   corner_max / 3);
+        w->tri_order = arena_alloc(scratch, sizeof(*w->tri_order) *
+                                   corner_max / 3);
+        w->planes = arena_alloc(scratch, sizeof(*w->planes) *
+                                corner_max / 3);
+        --w->mask;
+}
+
+/* Hashes the exact bits, with -0 and 0 the same place as they compare. */
+static uint32_t collision_weld_hash(const T3DVec3 *p, const uint32_t mask)
+{
+        uint32_t bits[3];
+
+        for (int k = 0; k < 3; ++k) {
+                float f;
+
+                f = p->v[k] + 0.f;
+                memcpy(bits + k, &f, sizeof(*bits));
+        }
+
+        return ((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^
+                (bits[2] * 83492791u)) & mask;
+}
+
+/*
+ * Index of the vertex at `p`, added if it's new, so vertices keep the
+ * order their corners were first seen in.
+ */
+static uint32_t collision_hull_add_vert(struct collision_hull *h,
+                                        struct collision_scratch *w,
+                                        const T3DVec3 *p)
+{
+        uint32_t hash;
+
+        hash = collision_weld_hash(p, w->mask);
+        for (uint32_t i = w->heads[hash]; i != UINT32_MAX; i = w->next[i])
+                if (h->vx[i] == p->v[0] && h->vy[i] == p->v[1] &&
+                    h->vz[i] == p->v[2])
+                        return i;
+
+        h->vx[h->vert_cnt] = p->v[0];
+        h->vy[h->vert_cnt] = p->v[1];
+        h->vz[h->vert_cnt] = p->v[2];
+        w->next[h->vert_cnt] = w->heads[hash];
+        w->heads[hash] = h->vert_cnt;
+
+        return h->vert_cnt++;
+}
+
+/*
+ * Packs the axis arrays back to back at their padded size. They're the last
+ * thing allocated, so the arena is simply wound back to their new end.
+ */
+static void collision_hull_pack_verts(struct collision_hull *h,
+                                      struct arena *ar, const size_t mark,
+                                      const uint32_t cap)
+{
+        uint32_t pad;
+
+        pad = COLLISION_SOA_PAD_CNT(h->vert_cnt);
+        for (uint32_t i = h->vert_cnt; i < pad; ++i) {
+                h->vx[i] = h->vx[0];
+                h->vy[i] = h->vy[0];
+                h->vz[i] = h->vz[0];
+        }
+
+        if (pad == cap)
+                return;
+
+        memmove(h->vx + pad, h->vy, sizeof(*h->vy) * pad);
+        memmove(h->vx + pad * 2, h->vz, sizeof(*h->vz) * pad);
+        arena_reset(ar, mark);
+        h->vx = arena_alloc(ar, sizeof(*h->vx) * pad * 3);
+        h->vy = h->vx + pad;
+        h->vz = h->vx + pad * 2;
+}
+
+static void collision_hull_get_vert(T3DVec3 *out,
+                                    const struct collision_hull *h,
+                                    const uint32_t i)
+{
+        *out = (T3DVec3){{h->vx[i], h->vy[i], h->vz[i]}};
+}
+
+static bool collision_face_has_plane(const struct collision_face *f,
+                                     const T3DVec3 *n, const float d)
+{
+        return t3d_vec3_dot(&f->normal, n) >= 1.f - COLLISION_FACE_EPS &&
+               fabsf(f->d - d) <= COLLISION_FACE_EPS;
+}
+
+static bool collision_triangle_get_plane(T3DVec3 *n, float *d,
+                                         const struct collision_triangle *t)
+{
+        T3DVec3 ab, ac;
+        float len;
+
+        t3d_vec3_diff(&ab, t->pos + 1, t->pos + 0);
+        t3d_vec3_diff(&ac, t->pos + 2, t->pos + 0);
+        t3d_vec3_cross(n, &ab, &ac);
+        len = t3d_vec3_len(n);
+        if (len <= COLLISION_FACE_EPS * COLLISION_FACE_EPS)
+                return false;
+
+        t3d_vec3_scale(n, n, 1.f / len);
+        *d = t3d_vec3_dot(n, t->pos + 0);
+
+        return true;
+}
+
+/* Orders a face's vertices by angle around its centroid. */
+static void collision_face_wind(const struct collision_hull *h,
+                                const struct collision_face *f,
+                                uint32_t *inds)
+{
+        T3DVec3 centre, u, w, p;
+        float angles[f->cnt];
+
+        centre = (T3DVec3){{0.f, 0.f, 0.f}};
+        for (uint32_t i = 0; i < f->cnt; ++i) {
+                collision_hull_get_vert(&p, h, inds[i]);
+                t3d_vec3_add(&centre, &centre, &p);
+        }
+
+        t3d_vec3_scale(&centre, &centre, 1.f / f->cnt);
+        collision_hull_get_vert(&p, h, inds[0]);
+        t3d_vec3_diff(&u, &p, &centre);
+        t3d_vec3_cross(&w, &f->normal, &u);
+        for (uint32_t i = 0; i < f->cnt; ++i) {
+                T3DVec3 off;
+
+                collision_hull_get_vert(&p, h, inds[i]);
+                t3d_vec3_diff(&off, &p, &centre);
+                angles[i] = atan2f(t3d_vec3_dot(&off, &w),
+                                   t3d_vec3_dot(&off, &u));
+        }
+
+        for (int i = 1; i < (int)f->cnt; ++i) {
+                uint32_t ind;
+                float ang;
+                int j;
+
+                ind = inds[i];
+                ang = angles[i];
+                for (j = i - 1; j >= 0 && angles[j] > ang; --j) {
+                        inds[j + 1] = inds[j];
+                        angles[j + 1] = angles[j];
+                }
+
+                inds[j + 1] = ind;
+                angles[j + 1] = ang;
+        }
+}
+
+/*
+ * Merges coplanar triangles into polygon faces for contact clipping. Only
+ * meaningful for convex hulls, where each plane holds a single polygon.
+ * Each triangle is matched to a plane once, then the triangles are taken
+ * face by face with their corners' vertices from the weld, stamped so each
+ * goes in once.
+ */
+static void collision_hull_build_faces(struct collision_hull *h,
+                                       struct collision_scratch *w,
+                                       struct arena *ar)
+{
+        struct collision_face *planes;
+        uint32_t vert_total, tri_total;
+        size_t mark;
+
+        planes = w->planes;
+        h->face_cnt = 0;
+        for (uint32_t i = 0; i < h->tri_cnt; ++i) {
+                T3DVec3 n;
+                float d;
+                uint32_t j;
+
+                w->tri_faces[i] = UINT32_MAX;
+                if (!collision_triangle_get_plane(&n, &d, h->tris + i))
+                        continue;
+
+                for (j = 0; j < h->face_cnt; ++j)
+                        if (collision_face_has_plane(planes + j, &n, d))
+                                break;
+
+                if (j == h->face_cnt) {
+                        planes[j].normal = n;
+                        planes[j].d = d;
+                        planes[j].cnt = 0;
+                        ++h->face_cnt;
+                }
+
+                w->tri_faces[i] = j;
+                ++planes[j].cnt;
+        }
+
+        /* Counting sort, `first` briefly into `tri_order` */
+        tri_total = 0;
+        for (uint32_t i = 0; i < h->face_cnt; ++i) {
+                planes[i].first = tri_total;
+                tri_total += planes[i].cnt;
+        }
+
+        for (uint32_t i = 0; i < h->tri_cnt; ++i)
+                if (w->tri_faces[i] != UINT32_MAX)
+                        w->tri_order[planes[w->tri_faces[i]].first++] = i;
+
+        h->faces = arena_alloc(ar, sizeof(*h->faces) * h->face_cnt);
+        mark = arena_mark(ar);
+        h->face_verts = arena_alloc(ar, sizeof(*h->face_verts) * tri_total * 3);
+        for (uint32_t i = 0; i < h->vert_cnt; ++i)
+                w->next[i] = UINT32_MAX;
+
+        vert_total = 0;
+        tri_total = 0;
+        for (uint32_t i = 0; i < h->face_cnt; ++i) {
+                struct collision_face *f;
+                uint32_t *inds;
+
+                f = h->faces + i;
+                f->normal = planes[i].normal;
+                f->d = planes[i].d;
+                f->first = vert_total;
+                f->cnt = 0;
+                inds = h->face_verts + f->first;
+                for (; tri_total < planes[i].first; ++tri_total) {
+                        const uint32_t *c;
+
+                        c = w->corners + w->tri_order[tri_total] * 3;
+                        for (int k = 0; k < 3; ++k) {
+                                if (w->next[c[k]] == i)
+                                        continue;
+
+                                w->next[c[k]] = i;
+                                inds[f->cnt++] = c[k];
+                        }
+                }
+
+                collision_face_wind(h, f, inds);
+                vert_total += f->cnt;
+        }
+
+        /* Last thing allocated, so trimming it is winding the arena back */
+        arena_reset(ar, mark);
+        h->face_verts = arena_alloc(ar, sizeof(*h->face_verts) * vert_total);
+}
+
+/* Unique vertices, faces and centre of one convex run of triangles. */
+static void collision_hull_build(struct collision_hull *h,
+                                 struct collision_scratch *w,
+                                 const struct collision_triangle *tris,
+                                 const uint32_t tri_cnt, struct arena *ar)
+{
+        uint32_t cap;
+        size_t mark;
+
+        h->tri_cnt = tri_cnt;
+        h->tris = tris;
+
+        /* Worst case every corner is unique, trimmed once they're known. */
+        cap = COLLISION_SOA_PAD_CNT(tri_cnt * 3);
+        h->centre = (T3DVec3){{0.f, 0.f, 0.f}};
+        h->vert_cnt = 0;
+        mark = arena_mark(ar);
+        h->vx = arena_alloc(ar, sizeof(*h->vx) * cap * 3);
+        h->vy = h->vx + cap;
+        h->vz = h->vx + cap * 2;
+        memset(w->heads, 0xFF, sizeof(*w->heads) * (w->mask + 1));
+        for (uint32_t i = 0; i < tri_cnt; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                        t3d_vec3_add(&h->centre, &h->centre,
+                                     tris[i].pos + j);
+                        w->corners[i * 3 + j] =
+                                collision_hull_add_vert(h, w, tris[i].pos + j);
+                }
+        }
+
+        if (tri_cnt)
+                t3d_vec3_scale(&h->centre, &h->centre, 1.f / (tri_cnt * 3));
+
+        if (h->vert_cnt)
+                collision_hull_pack_verts(h, ar, mark, cap);
+
+        collision_hull_build_faces(h, w, ar);
+
+#ifdef COLLISION_FIXED_POINT
+        collision_hull_quantise(h, ar);
+#endif
+}
+
+/*
+ * Everything kept comes from `ar`. Building the hulls borrows `scratch`,
+ * which is left as it was found.
+ */
+struct collision_data collision_data_load(const char *path, struct arena *ar,
+                                          struct arena *scratch)
+{
+        struct collision_scratch weld;
+        struct collision_data cd;
+        uint32_t hull_cnt, corner_max;
+        size_t mark;
+        FILE *f;
+
+        f = asset_fopen(path, NULL);
+
+        fread(&cd.tri_cnt, 4, 1, f);
+        cd.tris = arena_alloc(ar, sizeof(*cd.tris) * cd.tri_cnt);
+        fread(cd.tris, sizeof(*cd.tris), cd.tri_cnt, f);
+
+        /*
+         * Older files, and ones without `col_*` nodes, stop here. They've
+         * always collided as one hull, so that's what they stay.
+         */
+        if (fread(&cd.piece_cnt, 4, 1, f) == 1) {
+                cd.pieces = arena_alloc(ar, sizeof(*cd.pieces) *
+                                        cd.piece_cnt);
+                fread(cd.pieces, sizeof(*cd.pieces), cd.piece_cnt, f);
+        } else {
+                cd.piece_cnt = 1;
+                cd.pieces = arena_alloc(ar, sizeof(*cd.pieces));
+                cd.pieces->first = 0;
+                cd.pieces->cnt = cd.tri_cnt;
+                cd.pieces->flags = COLLISION_PIECE_CONVEX;
+        }
+
+        fclose(f);
+
+        hull_cnt = 0;
+        corner_max = 0;
+        for (uint32_t i = 0; i < cd.piece_cnt; ++i) {
+                if (!(cd.pieces[i].flags & COLLISION_PIECE_CONVEX))
+                        continue;
+
+                ++hull_cnt;
+                if (cd.pieces[i].cnt * 3 > corner_max)
+                        corner_max = cd.pieces[i].cnt * 3;
+        }
+
+        cd.hulls = arena_alloc(ar, sizeof(*cd.hulls) * hull_cnt);
+        cd.hull_cnt = 0;
+        mark = arena_mark(scratch);
+        collision_scratch_create(&weld, corner_max, scratch);
+        for (uint32_t i = 0; i < cd.piece_cnt; ++i) {
+                const struct collision_piece *p;
+
+                p = cd.pieces + i;
+                if (!(p->flags & COLLISION_PIECE_CONVEX))
+                        continue;
+
+                assertf(p->first + p->cnt <= cd.tri_cnt,
+                        "Piece %lu of %s is out of range", i, path);
+                collision_hull_build(cd.hulls + cd.hull_cnt++, &weld,
+                                     cd.tris + p->first, p->cnt, ar);
+        }
+
+        arena_reset(scratch, mark);
+
+        return cd;
+}
+
+#ifdef COLLISION_FIXED_POINT
+/* Builds the 16.16 vertex set and bounds the fixed-point GJK runs on. */
+void collision_hull_quantise(struct collision_hull *h, struct arena *ar)
+{
+        h->vert_cnt_fx = h->vert_cnt;
+        h->verts_fx = arena_alloc(ar, sizeof(*h->verts_fx) * h->vert_cnt);
+        for (uint32_t i = 0; i < h->vert_cnt; ++i) {
+                h->verts_fx[i].v[0] = FX_FROM_FLOAT(h->vx[i]);
+                h->verts_fx[i].v[1] = FX_FROM_FLOAT(h->vy[i]);
+                h->verts_fx[i].v[2] = FX_FROM_FLOAT(h->vz[i]);
+        }
+
+        h->bounds_fx.min = (struct fx_vec3){{0, 0, 0}};
+        h->bounds_fx.max = (struct fx_vec3){{0, 0, 0}};
+        for (uint32_t i = 0; i < h->vert_cnt_fx; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                        fixed32 x;
+
+                        x = h->verts_fx[i].v[k];
+                        if (!i || x < h->bounds_fx.min.v[k])
+                                h->bounds_fx.min.v[k] = x;
+
+                        if (!i || x > h->bounds_fx.max.v[k])
+                                h->bounds_fx.max.v[k] = x;
+                }
+        }
+}
+#endif
+
+/* Face whose normal is closest to `dir`, -1 if there are none. */
+int collision_hull_get_face(const struct collision_hull *h,
+                            const T3DVec3 *dir)
+{
+        float best;
+        int best_ind;
+
+        best = -INFINITY;
+        best_ind = -1;
+        for (uint32_t i = 0; i < h->face_cnt; ++i) {
+                float d;
+
+                d = t3d_vec3_dot(&h->faces[i].normal, dir);
+                if (d > best) {
+                        best = d;
+                        best_ind = i;
+                }
+        }
+
+        return best_ind;
+}
+
+/*
+ * Furthest vertex along `dir`, in the mesh's local space. Streams the axis
+ * arrays over their padded length, so the scan has no remainder and
+ * touches each cache line once.
+ */
+void collision_hull_support(T3DVec3 *out, const struct collision_hull *h,
+                            const T3DVec3 *dir)
+{
+        uint32_t i;
+
+        if (!h->vert_cnt) {
+                *out = (T3DVec3){{0.f, 0.f, 0.f}};
+                return;
+        }
+
+        i = max_dot(h->vx, h->vy, h->vz,
+                    COLLISION_SOA_PAD_CNT(h->vert_cnt), dir);
+        *out = (T3DVec3){{h->vx[i], h->vy[i], h->vz[i]}};
+}
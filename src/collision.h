@@ -0,0 +1,91 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <t3d/t3dmath.h>
+
+#include "arena.h"
+
+#ifdef COLLISION_FIXED_POINT
+#include "fixed.h"
+#endif
+
+#define COLLISION_SOA_PAD 8
+#define COLLISION_SOA_PAD_CNT(n) \
+        (((n) + COLLISION_SOA_PAD - 1) & ~(COLLISION_SOA_PAD - 1))
+
+#define COLLISION_FACE_EPS 1e-3f /* Coplanarity tolerance for merging */
+#define COLLISION_PIECE_CONVEX (1 << 0) /* Else part of the static mesh */
+
+struct collision_triangle {
+        T3DVec3 pos[3];
+};
+
+/* Convex polygon of coplanar triangles, vertices wound CCW about `normal`. */
+struct collision_face {
+        T3DVec3 normal;
+        float d;
+        uint32_t first; /* Into `face_verts` */
+        uint32_t cnt;
+};
+
+/* A run of `tris`, from a `col_*` node or the merged rest of the scene. */
+struct collision_piece {
+        uint32_t first;
+        uint32_t cnt;
+        uint32_t flags;
+};
+
+/*
+ * One convex `col_*` piece, which is what a SHAPE_HULL collides as. Files
+ * without a piece table load as a single hull over every triangle.
+ */
+struct collision_hull {
+        uint32_t tri_cnt;
+        const struct collision_triangle *tris; /* Into the mesh's `tris` */
+        T3DVec3 centre; /* Vertex average, always inside a convex hull */
+
+        /*
+         * Unique vertices split per axis for support scans. Arrays hold
+         * COLLISION_SOA_PAD_CNT(vert_cnt) entries, the tail repeating the
+         * first vertex so it never wins a max.
+         */
+        uint32_t vert_cnt;
+        float *vx;
+        float *vy;
+        float *vz;
+
+        uint32_t face_cnt;
+        struct collision_face *faces;
+        uint32_t *face_verts; /* Indices into the vertex arrays */
+#ifdef COLLISION_FIXED_POINT
+        uint32_t vert_cnt_fx;
+        struct fx_vec3 *verts_fx; /* Unique vertices, quantised */
+        struct fx_aabb bounds_fx;
+#endif
+};
+
+/*
+ * Everything loaded from one `.cm` file. Triangles of pieces without
+ * COLLISION_PIECE_CONVEX are a static, possibly concave mesh that is only
+ * collided with triangle by triangle.
+ */
+struct collision_data {
+        uint32_t tri_cnt;
+        struct collision_triangle *tris;
+        uint32_t piece_cnt; /* At least one, covering every triangle */
+        struct collision_piece *pieces;
+        uint32_t hull_cnt;
+        struct collision_hull *hulls; /* Per convex piece, in piece order */
+};
+
+struct collision_data collision_data_load(const char *path, struct arena *ar,
+                                          struct arena *scratch);
+#ifdef COLLISION_FIXED_POINT
+void collision_hull_quantise(struct collision_hull *h, struct arena *ar);
+#endif
+int collision_hull_get_face(const struct collision_hull *h,
+                            const T3DVec3 *dir);
+void collision_hull_support(T3DVec3 *out, const struct collision_hull *h,
+                            const T3DVec3 *dir);
+
+#endif /* COLLISION_H */
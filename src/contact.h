@@ -0,0 +1,13 @@
+#ifndef CONTACT_H
+#define CONTACT_H
+
+#include <t3d/t3dmath.h>
+
+struct contact {
+        T3DVec3 point_a; /* Deepest point of A inside B */
+        T3DVec3 point_b; /* Deepest point of B inside A */
+        T3DVec3 normal; /* From A towards B */
+        float depth;
+};
+
+#endif /* CONTACT_H */
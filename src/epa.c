@@ -0,0 +1,312 @@
+#include <libdragon.h>
+
+#include "epa.h"
+
+struct epa_face {
+        int v[3];
+        T3DVec3 n; /* Outward, unit length */
+        float d; /* Distance of the plane from the origin */
+};
+
+struct epa_polytope {
+        struct gjk_vertex verts[EPA_VERT_MAX];
+        struct epa_face faces[EPA_FACE_MAX];
+        T3DVec3 centre; /* Any interior point, to tell outwards apart */
+        int vert_cnt;
+        int face_cnt;
+};
+
+static bool epa_face_add(struct epa_polytope *p, const int a, const int b,
+                         const int c)
+{
+        struct epa_face *f;
+        T3DVec3 ab, ac, to_face;
+        float len;
+
+        if (p->face_cnt >= EPA_FACE_MAX)
+                return false;
+
+        f = p->faces + p->face_cnt;
+        t3d_vec3_diff(&ab, &p->verts[b].w, &p->verts[a].w);
+        t3d_vec3_diff(&ac, &p->verts[c].w, &p->verts[a].w);
+        t3d_vec3_cross(&f->n, &ab, &ac);
+        len = t3d_vec3_len(&f->n);
+        if (len <= EPA_EPS * EPA_EPS)
+                return false;
+
+        t3d_vec3_scale(&f->n, &f->n, 1.f / len);
+        f->v[0] = a;
+        f->v[1] = b;
+        f->v[2] = c;
+
+        /* Keep the winding facing away from the inside. */
+        t3d_vec3_diff(&to_face, &p->verts[a].w, &p->centre);
+        if (t3d_vec3_dot(&f->n, &to_face) < 0.f) {
+                f->v[1] = c;
+                f->v[2] = b;
+                t3d_vec3_scale(&f->n, &f->n, -1.f);
+        }
+
+        f->d = t3d_vec3_dot(&f->n, &p->verts[a].w);
+        ++p->face_cnt;
+
+        return true;
+}
+
+/*
+ * GJK can bail out with fewer than 4 vertices when the shapes only just
+ * touch, so search outwards until the simplex has some volume again.
+ */
+static int epa_expand_simplex(struct gjk_vertex *verts, int cnt,
+                              const struct shape *a, const struct shape *b)
+{
+        static const T3DVec3 axes[6] = {
+                {{1.f, 0.f, 0.f}}, {{-1.f, 0.f, 0.f}},
+                {{0.f, 1.f, 0.f}}, {{0.f, -1.f, 0.f}},
+                {{0.f, 0.f, 1.f}}, {{0.f, 0.f, -1.f}}
+        };
+
+        while (cnt < 4) {
+                T3DVec3 dirs[6];
+                int dir_cnt;
+                bool grew;
+
+                dir_cnt = 0;
+                if (cnt == 1) {
+                        for (int i = 0; i < 6; ++i)
+                                dirs[dir_cnt++] = axes[i];
+                } else if (cnt == 2) {
+                        T3DVec3 line, axis, e1, e2;
+                        int min_axis;
+
+                        t3d_vec3_diff(&line, &verts[1].w, &verts[0].w);
+                        min_axis = 0;
+                        for (int i = 1; i < 3; ++i)
+                                if (fabsf(line.v[i]) < fabsf(line.v[min_axis]))
+                                        min_axis = i;
+
+                        axis = axes[min_axis * 2];
+                        t3d_vec3_cross(&e1, &line, &axis);
+                        t3d_vec3_cross(&e2, &line, &e1);
+                        dirs[dir_cnt++] = e1;
+                        dirs[dir_cnt++] = e2;
+                        t3d_vec3_scale(dirs + dir_cnt++, &e1, -1.f);
+                        t3d_vec3_scale(dirs + dir_cnt++, &e2, -1.f);
+                } else {
+                        T3DVec3 ab, ac, n;
+
+                        t3d_vec3_diff(&ab, &verts[1].w, &verts[0].w);
+                        t3d_vec3_diff(&ac, &verts[2].w, &verts[0].w);
+                        t3d_vec3_cross(&n, &ab, &ac);
+                        dirs[dir_cnt++] = n;
+                        t3d_vec3_scale(dirs + dir_cnt++, &n, -1.f);
+                }
+
+                grew = false;
+                for (int i = 0; i < dir_cnt && !grew; ++i) {
+                        struct gjk_vertex w;
+                        T3DVec3 off;
+
+                        gjk_support(&w, a, b, dirs + i);
+                        t3d_vec3_diff(&off, &w.w, &verts[0].w);
+                        if (cnt == 1) {
+                                grew = t3d_vec3_len2(&off) > EPA_EPS;
+                        } else if (cnt == 2) {
+                                T3DVec3 line, perp;
+
+                                t3d_vec3_diff(&line, &verts[1].w,
+                                              &verts[0].w);
+                                t3d_vec3_cross(&perp, &line, &off);
+                                grew = t3d_vec3_len2(&perp) > EPA_EPS *
+                                       t3d_vec3_len2(&line);
+                        } else {
+                                float along;
+
+                                along = t3d_vec3_dot(&off, dirs + i);
+                                grew = along * along > EPA_EPS *
+                                       t3d_vec3_len2(dirs + i);
+                        }
+
+                        if (grew)
+                                verts[cnt++] = w;
+                }
+
+                if (!grew)
+                        break;
+        }
+
+        return cnt;
+}
+
+static void epa_edge_toggle(int (*edges)[2], int *edge_cnt,
+                            const int a, const int b)
+{
+        /* Shared with an already removed face, so not on the horizon. */
+        for (int i = 0; i < *edge_cnt; ++i) {
+                if (edges[i][0] == b && edges[i][1] == a) {
+                        edges[i][0] = edges[*edge_cnt - 1][0];
+                        edges[i][1] = edges[*edge_cnt - 1][1];
+                        --(*edge_cnt);
+                        return;
+                }
+        }
+
+        edges[*edge_cnt][0] = a;
+        edges[*edge_cnt][1] = b;
+        ++(*edge_cnt);
+}
+
+static const struct epa_face *epa_closest_face(const struct epa_polytope *p)
+{
+        const struct epa_face *best;
+
+        best = p->faces;
+        for (int i = 1; i < p->face_cnt; ++i)
+                if (p->faces[i].d < best->d)
+                        best = p->faces + i;
+
+        return best;
+}
+
+/*
+ * Contact from a face of A - B with plane normal `n` at distance `d`, using
+ * the barycentrics of the origin projected onto it.
+ */
+void epa_contact_from_triangle(struct contact *c, const struct gjk_vertex *va,
+                               const struct gjk_vertex *vb,
+                               const struct gjk_vertex *vc,
+                               const T3DVec3 *n, const float d)
+{
+        T3DVec3 v0, v1, v2, proj, tmp;
+        float d00, d01, d11, d20, d21, denom, bc[3];
+
+        t3d_vec3_scale(&proj, n, d);
+        t3d_vec3_diff(&v0, &vb->w, &va->w);
+        t3d_vec3_diff(&v1, &vc->w, &va->w);
+        t3d_vec3_diff(&v2, &proj, &va->w);
+        d00 = t3d_vec3_dot(&v0, &v0);
+        d01 = t3d_vec3_dot(&v0, &v1);
+        d11 = t3d_vec3_dot(&v1, &v1);
+        d20 = t3d_vec3_dot(&v2, &v0);
+        d21 = t3d_vec3_dot(&v2, &v1);
+        denom = d00 * d11 - d01 * d01;
+        if (denom) {
+                bc[1] = (d11 * d20 - d01 * d21) / denom;
+                bc[2] = (d00 * d21 - d01 * d20) / denom;
+                bc[0] = 1.f - bc[1] - bc[2];
+        } else {
+                bc[0] = 1.f;
+                bc[1] = 0.f;
+                bc[2] = 0.f;
+        }
+
+        t3d_vec3_scale(&c->point_a, &va->a, bc[0]);
+        t3d_vec3_scale(&tmp, &vb->a, bc[1]);
+        t3d_vec3_add(&c->point_a, &c->point_a, &tmp);
+        t3d_vec3_scale(&tmp, &vc->a, bc[2]);
+        t3d_vec3_add(&c->point_a, &c->point_a, &tmp);
+
+        t3d_vec3_scale(&c->point_b, &va->b, bc[0]);
+        t3d_vec3_scale(&tmp, &vb->b, bc[1]);
+        t3d_vec3_add(&c->point_b, &c->point_b, &tmp);
+        t3d_vec3_scale(&tmp, &vc->b, bc[2]);
+        t3d_vec3_add(&c->point_b, &c->point_b, &tmp);
+
+        c->normal = *n;
+        c->depth = d;
+}
+
+static void epa_contact_from_face(struct contact *c,
+                                  const struct epa_polytope *p,
+                                  const struct epa_face *f)
+{
+        epa_contact_from_triangle(c, p->verts + f->v[0], p->verts + f->v[1],
+                                  p->verts + f->v[2], &f->n, f->d);
+}
+
+/*
+ * Expanding Polytope Algorithm: grows the final GJK simplex towards the
+ * boundary of A - B until the face nearest the origin stops moving, which
+ * gives the minimum translation (normal * depth) separating A from B.
+ */
+void epa_penetration(struct contact *c, const struct gjk_simplex *s,
+                     const struct shape *a, const struct shape *b)
+{
+        static const int tetra[4][3] = {
+                {0, 1, 2}, {0, 3, 1}, {0, 2, 3}, {1, 3, 2}
+        };
+        struct epa_polytope p;
+        const struct epa_face *best;
+        bool ok;
+
+        for (int i = 0; i < s->cnt; ++i)
+                p.verts[i] = s->v[i];
+
+        p.vert_cnt = epa_expand_simplex(p.verts, s->cnt, a, b);
+        p.face_cnt = 0;
+        p.centre = (T3DVec3){{0.f, 0.f, 0.f}};
+        for (int i = 0; i < p.vert_cnt; ++i)
+                t3d_vec3_add(&p.centre, &p.centre, &p.verts[i].w);
+
+        t3d_vec3_scale(&p.centre, &p.centre, 1.f / p.vert_cnt);
+
+        ok = (p.vert_cnt == 4);
+        for (int i = 0; i < 4 && ok; ++i)
+                ok = epa_face_add(&p, tetra[i][0], tetra[i][1], tetra[i][2]);
+
+        /* Flat Minkowski difference, they're just touching. */
+        if (!ok) {
+                t3d_vec3_diff(&c->normal, &b->pos, &a->pos);
+                if (!t3d_vec3_len2(&c->normal))
+                        c->normal = (T3DVec3){{0.f, 0.f, 1.f}};
+
+                t3d_vec3_norm(&c->normal);
+                c->point_a = p.verts[0].a;
+                c->point_b = p.verts[0].b;
+                c->depth = 0.f;
+                return;
+        }
+
+        for (int iter = 0; iter < EPA_ITER_MAX; ++iter) {
+                int edges[EPA_FACE_MAX * 3][2];
+                struct gjk_vertex w;
+                int edge_cnt, w_ind;
+
+                best = epa_closest_face(&p);
+                epa_contact_from_face(c, &p, best);
+                gjk_support(&w, a, b, &best->n);
+                if (t3d_vec3_dot(&w.w, &best->n) - best->d < EPA_EPS)
+                        break;
+
+                if (p.vert_cnt >= EPA_VERT_MAX)
+                        break;
+
+                /* Carve out every face `w` can see, keeping the horizon. */
+                edge_cnt = 0;
+                for (int i = p.face_cnt - 1; i >= 0; --i) {
+                        struct epa_face *f;
+
+                        f = p.faces + i;
+                        if (t3d_vec3_dot(&f->n, &w.w) - f->d <= 0.f)
+                                continue;
+
+                        epa_edge_toggle(edges, &edge_cnt, f->v[0], f->v[1]);
+                        epa_edge_toggle(edges, &edge_cnt, f->v[1], f->v[2]);
+                        epa_edge_toggle(edges, &edge_cnt, f->v[2], f->v[0]);
+                        *f = p.faces[--p.face_cnt];
+                }
+
+                w_ind = p.vert_cnt++;
+                p.verts[w_ind] = w;
+                ok = true;
+                for (int i = 0; i < edge_cnt && ok; ++i)
+                        ok = epa_face_add(&p, edges[i][0], edges[i][1], w_ind);
+
+                /* Polytope is no longer closed, keep the last good face. */
+                if (!ok || !p.face_cnt)
+                        return;
+        }
+
+        best = epa_closest_face(&p);
+        epa_contact_from_face(c, &p, best);
+}
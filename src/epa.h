@@ -0,0 +1,19 @@
+#ifndef EPA_H
+#define EPA_H
+
+#include "contact.h"
+#include "gjk.h"
+
+#define EPA_ITER_MAX 32
+#define EPA_VERT_MAX (EPA_ITER_MAX + 4)
+#define EPA_FACE_MAX (EPA_VERT_MAX * 2)
+#define EPA_EPS 1e-4f
+
+void epa_contact_from_triangle(struct contact *c, const struct gjk_vertex *va,
+                               const struct gjk_vertex *vb,
+                               const struct gjk_vertex *vc,
+                               const T3DVec3 *n, const float d);
+void epa_penetration(struct contact *c, const struct gjk_simplex *s,
+                     const struct shape *a, const struct shape *b);
+
+#endif /* EPA_H */
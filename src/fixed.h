@@ -0,0 +1,111 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+/* 16.16 fixed point, with 32.32 for products that need the headroom. */
+typedef int32_t fixed32;
+typedef int64_t fixed64;
+
+#define FX_SHIFT 16
+#define FX_ONE (1 << FX_SHIFT)
+#define FX_FROM_FLOAT(X) ((fixed32)((X) * (float)FX_ONE))
+#define FX_TO_FLOAT(X) ((float)(X) * (1.f / FX_ONE))
+
+struct fx_vec3 {
+        fixed32 v[3];
+};
+
+struct fx_aabb {
+        struct fx_vec3 min;
+        struct fx_vec3 max;
+};
+
+static inline void fx_vec3_add(struct fx_vec3 *out, const struct fx_vec3 *a,
+                               const struct fx_vec3 *b)
+{
+        for (int i = 0; i < 3; ++i)
+                out->v[i] = a->v[i] + b->v[i];
+}
+
+static inline void fx_vec3_diff(struct fx_vec3 *out, const struct fx_vec3 *a,
+                                const struct fx_vec3 *b)
+{
+        for (int i = 0; i < 3; ++i)
+                out->v[i] = a->v[i] - b->v[i];
+}
+
+/* Result is 32.32. */
+static inline fixed64 fx_vec3_dot(const struct fx_vec3 *a,
+                                  const struct fx_vec3 *b)
+{
+        return (fixed64)a->v[0] * b->v[0] + (fixed64)a->v[1] * b->v[1] +
+               (fixed64)a->v[2] * b->v[2];
+}
+
+/* Scales by a 16.16 factor. */
+static inline void fx_vec3_scale(struct fx_vec3 *out, const struct fx_vec3 *a,
+                                 const fixed32 s)
+{
+        for (int i = 0; i < 3; ++i)
+                out->v[i] = (fixed32)(((fixed64)a->v[i] * s) >> FX_SHIFT);
+}
+
+/* Result is 16.16, the full 32.32 cross product rarely fits. */
+static inline void fx_vec3_cross(struct fx_vec3 *out, const struct fx_vec3 *a,
+                                 const struct fx_vec3 *b)
+{
+        struct fx_vec3 tmp;
+
+        tmp.v[0] = (fixed32)(((fixed64)a->v[1] * b->v[2] -
+                              (fixed64)a->v[2] * b->v[1]) >> FX_SHIFT);
+        tmp.v[1] = (fixed32)(((fixed64)a->v[2] * b->v[0] -
+                              (fixed64)a->v[0] * b->v[2]) >> FX_SHIFT);
+        tmp.v[2] = (fixed32)(((fixed64)a->v[0] * b->v[1] -
+                              (fixed64)a->v[1] * b->v[0]) >> FX_SHIFT);
+        *out = tmp;
+}
+
+/* `num / den` as 16.16, for 0 <= num <= den. */
+static inline fixed32 fx_ratio(fixed64 num, fixed64 den)
+{
+        while (den > ((fixed64)1 << 46)) {
+                num >>= 1;
+                den >>= 1;
+        }
+
+        if (!den)
+                return 0;
+
+        return (fixed32)((num << FX_SHIFT) / den);
+}
+
+/* Square root of a 32.32 value as 16.16, without touching the FPU. */
+static inline fixed32 fx_sqrt_wide(fixed64 x)
+{
+        uint64_t rem, root, bit;
+
+        if (x <= 0)
+                return 0;
+
+        rem = (uint64_t)x;
+        root = 0;
+        bit = (uint64_t)1 << 62;
+        while (bit > rem)
+                bit >>= 2;
+
+        while (bit) {
+                if (rem >= root + bit) {
+                        rem -= root + bit;
+                        root = (root >> 1) + bit;
+                } else {
+                        root >>= 1;
+                }
+
+                bit >>= 2;
+        }
+
+        return (fixed32)root;
+}
+
+#endif /* FIXED_H */
@@ -0,0 +1,506 @@
+#include <libdragon.h>
+
+#include "gjk.h"
+#include "gjk_fixed.h"
+
+void gjk_support(struct gjk_vertex *out, const struct shape *a,
+                 const struct shape *b, const T3DVec3 *dir)
+{
+        T3DVec3 dir_neg;
+
+        t3d_vec3_scale(&dir_neg, dir, -1.f);
+        shape_support(&out->a, a, dir);
+        shape_support(&out->b, b, &dir_neg);
+        t3d_vec3_diff(&out->w, &out->a, &out->b);
+}
+
+static void gjk_simplex_set_point(struct gjk_simplex *s,
+                                  const struct gjk_vertex *a)
+{
+        s->v[0] = *a;
+        s->bc[0] = 1.f;
+        s->cnt = 1;
+}
+
+static void gjk_simplex_set_segment(struct gjk_simplex *s,
+                                    const struct gjk_vertex *a,
+                                    const struct gjk_vertex *b, const float t)
+{
+        struct gjk_vertex va, vb;
+
+        va = *a;
+        vb = *b;
+        s->v[0] = va;
+        s->v[1] = vb;
+        s->bc[0] = 1.f - t;
+        s->bc[1] = t;
+        s->cnt = 2;
+}
+
+static void gjk_simplex_get_point(T3DVec3 *out, const struct gjk_simplex *s)
+{
+        *out = (T3DVec3){{0.f, 0.f, 0.f}};
+        for (int i = 0; i < s->cnt; ++i) {
+                T3DVec3 tmp;
+
+                t3d_vec3_scale(&tmp, &s->v[i].w, s->bc[i]);
+                t3d_vec3_add(out, out, &tmp);
+        }
+}
+
+static float gjk_simplex_get_dist2(const struct gjk_simplex *s)
+{
+        T3DVec3 p;
+
+        gjk_simplex_get_point(&p, s);
+
+        return t3d_vec3_len2(&p);
+}
+
+/* Closest point on segment `ab` to the origin. */
+static void gjk_closest_segment(struct gjk_simplex *out,
+                                const struct gjk_vertex *a,
+                                const struct gjk_vertex *b)
+{
+        T3DVec3 ab;
+        float t, ab_len2;
+
+        t3d_vec3_diff(&ab, &b->w, &a->w);
+        t = -t3d_vec3_dot(&a->w, &ab);
+        if (t <= 0.f) {
+                gjk_simplex_set_point(out, a);
+                return;
+        }
+
+        ab_len2 = t3d_vec3_len2(&ab);
+        if (t >= ab_len2) {
+                gjk_simplex_set_point(out, b);
+                return;
+        }
+
+        gjk_simplex_set_segment(out, a, b, t / ab_len2);
+}
+
+/* Closest point on triangle `abc` to the origin (Ericson, RTCD 5.1.5). */
+static void gjk_closest_triangle(struct gjk_simplex *out,
+                                 const struct gjk_vertex *a,
+                                 const struct gjk_vertex *b,
+                                 const struct gjk_vertex *c)
+{
+        struct gjk_vertex va, vb, vc;
+        T3DVec3 ab, ac;
+        float d1, d2, d3, d4, d5, d6;
+        float area_a, area_b, area_c, denom;
+
+        va = *a;
+        vb = *b;
+        vc = *c;
+        t3d_vec3_diff(&ab, &vb.w, &va.w);
+        t3d_vec3_diff(&ac, &vc.w, &va.w);
+
+        d1 = -t3d_vec3_dot(&ab, &va.w);
+        d2 = -t3d_vec3_dot(&ac, &va.w);
+        if (d1 <= 0.f && d2 <= 0.f) {
+                gjk_simplex_set_point(out, &va);
+                return;
+        }
+
+        d3 = -t3d_vec3_dot(&ab, &vb.w);
+        d4 = -t3d_vec3_dot(&ac, &vb.w);
+        if (d3 >= 0.f && d4 <= d3) {
+                gjk_simplex_set_point(out, &vb);
+                return;
+        }
+
+        area_c = d1 * d4 - d3 * d2;
+        if (area_c <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+                gjk_simplex_set_segment(out, &va, &vb, d1 / (d1 - d3));
+                return;
+        }
+
+        d5 = -t3d_vec3_dot(&ab, &vc.w);
+        d6 = -t3d_vec3_dot(&ac, &vc.w);
+        if (d6 >= 0.f && d5 <= d6) {
+                gjk_simplex_set_point(out, &vc);
+                return;
+        }
+
+        area_b = d5 * d2 - d1 * d6;
+        if (area_b <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+                gjk_simplex_set_segment(out, &va, &vc, d2 / (d2 - d6));
+                return;
+        }
+
+        area_a = d3 * d6 - d5 * d4;
+        if (area_a <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) {
+                gjk_simplex_set_segment(out, &vb, &vc,
+                                        (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+                return;
+        }
+
+        /* Degenerate (collinear) triangle, settle for its longest edge. */
+        denom = area_a + area_b + area_c;
+        if (denom <= 0.f) {
+                struct gjk_simplex s_ab, s_ac, s_bc;
+                float d_ab, d_ac, d_bc;
+
+                gjk_closest_segment(&s_ab, &va, &vb);
+                gjk_closest_segment(&s_ac, &va, &vc);
+                gjk_closest_segment(&s_bc, &vb, &vc);
+                d_ab = gjk_simplex_get_dist2(&s_ab);
+                d_ac = gjk_simplex_get_dist2(&s_ac);
+                d_bc = gjk_simplex_get_dist2(&s_bc);
+                if (d_ab <= d_ac && d_ab <= d_bc)
+                        *out = s_ab;
+                else if (d_ac <= d_bc)
+                        *out = s_ac;
+                else
+                        *out = s_bc;
+
+                return;
+        }
+
+        denom = 1.f / denom;
+        out->v[0] = va;
+        out->v[1] = vb;
+        out->v[2] = vc;
+        out->bc[1] = area_b * denom;
+        out->bc[2] = area_c * denom;
+        out->bc[0] = 1.f - out->bc[1] - out->bc[2];
+        out->cnt = 3;
+}
+
+/* Whether the origin and `d` lie on opposite sides of plane `abc`. */
+static bool gjk_origin_outside_plane(const T3DVec3 *a, const T3DVec3 *b,
+                                     const T3DVec3 *c, const T3DVec3 *d)
+{
+        T3DVec3 ab, ac, ad, n;
+        float sign_o, sign_d;
+
+        t3d_vec3_diff(&ab, b, a);
+        t3d_vec3_diff(&ac, c, a);
+        t3d_vec3_diff(&ad, d, a);
+        t3d_vec3_cross(&n, &ab, &ac);
+        sign_o = -t3d_vec3_dot(a, &n);
+        sign_d = t3d_vec3_dot(&ad, &n);
+
+        /* A flat tetrahedron can't enclose anything. */
+        if (sign_d == 0.f)
+                return true;
+
+        return sign_o * sign_d < 0.f;
+}
+
+/* Returns true if the tetrahedron encloses the origin. */
+static bool gjk_closest_tetrahedron(struct gjk_simplex *s)
+{
+        static const int faces[4][4] = {
+                {0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}
+        };
+        struct gjk_simplex best;
+        float best_dist2;
+        bool outside;
+
+        outside = false;
+        best_dist2 = INFINITY;
+        for (int i = 0; i < 4; ++i) {
+                const struct gjk_vertex *a, *b, *c, *d;
+                struct gjk_simplex cand;
+                float dist2;
+
+                a = s->v + faces[i][0];
+                b = s->v + faces[i][1];
+                c = s->v + faces[i][2];
+                d = s->v + faces[i][3];
+                if (!gjk_origin_outside_plane(&a->w, &b->w, &c->w, &d->w))
+                        continue;
+
+                outside = true;
+                gjk_closest_triangle(&cand, a, b, c);
+                dist2 = gjk_simplex_get_dist2(&cand);
+                if (dist2 < best_dist2) {
+                        best_dist2 = dist2;
+                        best = cand;
+                }
+        }
+
+        if (!outside)
+                return true;
+
+        *s = best;
+
+        return false;
+}
+
+/* Reduces the simplex to the smallest subset supporting the closest point. */
+static bool gjk_simplex_solve(struct gjk_simplex *s)
+{
+        switch (s->cnt) {
+                case 2:
+                        gjk_closest_segment(s, s->v + 0, s->v + 1);
+                        return false;
+
+                case 3:
+                        gjk_closest_triangle(s, s->v + 0, s->v + 1, s->v + 2);
+                        return false;
+
+                case 4:
+                        return gjk_closest_tetrahedron(s);
+
+                default:
+                        return false;
+        }
+}
+
+/*
+ * Also hands back the final simplex, for EPA to start from. With a `cache`
+ * the search starts along last query's normal, which for a pair that has
+ * barely moved lands on the closest feature straight away.
+ */
+bool gjk_distance_cached(struct gjk_result *res, struct gjk_simplex *sp,
+                         const struct shape *a, const struct shape *b,
+                         struct gjk_cache *cache)
+{
+        struct gjk_simplex s;
+        T3DVec3 v, dir;
+        float dist2;
+
+        res->intersecting = false;
+
+        /* Any direction works as a seed, towards B converges quickest. */
+        if (cache && cache->valid)
+                dir = cache->normal;
+        else
+                t3d_vec3_diff(&dir, &b->pos, &a->pos);
+
+        if (!t3d_vec3_len2(&dir))
+                dir = (T3DVec3){{1.f, 0.f, 0.f}};
+
+        gjk_support(s.v + 0, a, b, &dir);
+        s.bc[0] = 1.f;
+        s.cnt = 1;
+        v = s.v[0].w;
+        dist2 = t3d_vec3_len2(&v);
+
+        for (int iter = 0; iter < GJK_ITER_MAX; ++iter) {
+                struct gjk_simplex prev;
+                struct gjk_vertex w;
+                T3DVec3 v_prev;
+                float dist2_prev;
+                bool dup;
+
+                if (dist2 <= GJK_EPS_ABS) {
+                        res->intersecting = true;
+                        break;
+                }
+
+                t3d_vec3_scale(&dir, &v, -1.f);
+                gjk_support(&w, a, b, &dir);
+
+                /* No further progress possible towards the origin. */
+                if (dist2 - t3d_vec3_dot(&v, &w.w) <= GJK_EPS_REL * dist2)
+                        break;
+
+                dup = false;
+                for (int i = 0; i < s.cnt; ++i)
+                        dup |= !memcmp(&s.v[i].w, &w.w, sizeof(w.w));
+
+                if (dup)
+                        break;
+
+                prev = s;
+                s.v[s.cnt++] = w;
+                if (gjk_simplex_solve(&s)) {
+                        res->intersecting = true;
+                        break;
+                }
+
+                dist2_prev = dist2;
+                v_prev = v;
+                gjk_simplex_get_point(&v, &s);
+                dist2 = t3d_vec3_len2(&v);
+
+                /*
+                 * Rounding on curved supports, e.g. a margin, can make the
+                 * last step worse, so keep the simplex from before it.
+                 */
+                if (dist2 >= dist2_prev) {
+                        s = prev;
+                        v = v_prev;
+                        dist2 = dist2_prev;
+                        break;
+                }
+        }
+
+        /* Closest points from the barycentric weights of the simplex. */
+        res->point_a = (T3DVec3){{0.f, 0.f, 0.f}};
+        res->point_b = (T3DVec3){{0.f, 0.f, 0.f}};
+        if (s.cnt < 4) {
+                for (int i = 0; i < s.cnt; ++i) {
+                        T3DVec3 tmp;
+
+                        t3d_vec3_scale(&tmp, &s.v[i].a, s.bc[i]);
+                        t3d_vec3_add(&res->point_a, &res->point_a, &tmp);
+                        t3d_vec3_scale(&tmp, &s.v[i].b, s.bc[i]);
+                        t3d_vec3_add(&res->point_b, &res->point_b, &tmp);
+                }
+        }
+
+        if (res->intersecting) {
+                res->distance = 0.f;
+                t3d_vec3_diff(&res->normal, &b->pos, &a->pos);
+        } else {
+                res->distance = sqrtf(dist2);
+                t3d_vec3_scale(&res->normal, &v, -1.f);
+        }
+
+        t3d_vec3_norm(&res->normal);
+        *sp = s;
+        if (cache) {
+                cache->normal = res->normal;
+                cache->valid = true;
+        }
+
+        return res->intersecting;
+}
+
+bool gjk_distance_simplex(struct gjk_result *res, struct gjk_simplex *sp,
+                          const struct shape *a, const struct shape *b)
+{
+        return gjk_distance_cached(res, sp, a, b, NULL);
+}
+
+#ifdef COLLISION_FIXED_POINT
+/* Plain translated hulls are all the integer kernel handles. */
+static bool gjk_fixed_handles(const struct shape *a, const struct shape *b)
+{
+        return a->type == SHAPE_HULL && b->type == SHAPE_HULL &&
+               !a->axes && !b->axes && !a->margin && !b->margin;
+}
+
+static void gjk_fixed_get_pos(struct fx_vec3 *out, const struct shape *s)
+{
+        for (int i = 0; i < 3; ++i)
+                out->v[i] = FX_FROM_FLOAT(s->pos.v[i]);
+}
+
+/*
+ * False only when both are plain hulls whose quantised bounds are apart,
+ * so a boolean query can stop before any float work.
+ */
+bool gjk_fixed_may_touch(const struct shape *a, const struct shape *b)
+{
+        struct fx_vec3 pos_a, pos_b;
+
+        if (!gjk_fixed_handles(a, b))
+                return true;
+
+        gjk_fixed_get_pos(&pos_a, a);
+        gjk_fixed_get_pos(&pos_b, b);
+
+        return fx_aabb_overlap(&a->hull->bounds_fx, &pos_a,
+                               &b->hull->bounds_fx, &pos_b);
+}
+
+static bool gjk_distance_fixed(struct gjk_result *res, const struct shape *a,
+                               const struct shape *b)
+{
+        struct gjk_fixed_result fres;
+        struct fx_vec3 pos_a, pos_b;
+
+        gjk_fixed_get_pos(&pos_a, a);
+        gjk_fixed_get_pos(&pos_b, b);
+        gjk_fixed_distance(&fres, a->hull, &pos_a, b->hull, &pos_b);
+        for (int i = 0; i < 3; ++i) {
+                res->point_a.v[i] = FX_TO_FLOAT(fres.point_a.v[i]);
+                res->point_b.v[i] = FX_TO_FLOAT(fres.point_b.v[i]);
+        }
+
+        res->intersecting = fres.intersecting;
+        res->distance = FX_TO_FLOAT(fres.distance);
+        if (res->intersecting)
+                t3d_vec3_diff(&res->normal, &b->pos, &a->pos);
+        else
+                t3d_vec3_diff(&res->normal, &res->point_b, &res->point_a);
+
+        t3d_vec3_norm(&res->normal);
+
+        return res->intersecting;
+}
+#endif
+
+bool gjk_distance(struct gjk_result *res, const struct shape *a,
+                  const struct shape *b)
+{
+        struct gjk_simplex s;
+
+#ifdef COLLISION_FIXED_POINT
+        if (gjk_fixed_handles(a, b))
+                return gjk_distance_fixed(res, a, b);
+#endif
+
+        return gjk_distance_simplex(res, &s, a, b);
+}
+
+/*
+ * Conservative advancement: step along the relative motion by the current
+ * separation over the closing speed, which can never skip past contact.
+ * `res`, if given, receives the query at the returned fraction.
+ */
+bool gjk_time_of_impact(float *toi, struct gjk_result *res,
+                        const struct shape *a, const T3DVec3 *move_a,
+                        const struct shape *b, const T3DVec3 *move_b)
+{
+        struct gjk_result res_tmp;
+        struct shape sa, sb;
+        T3DVec3 vel;
+        float t;
+
+        if (!res)
+                res = &res_tmp;
+
+        t3d_vec3_diff(&vel, move_a, move_b);
+        sa = *a;
+        sb = *b;
+
+        t = 0.f;
+        for (int iter = 0; iter < GJK_TOI_ITER_MAX; ++iter) {
+                float closing;
+
+                t3d_vec3_scale(&sa.pos, move_a, t);
+                t3d_vec3_add(&sa.pos, &sa.pos, &a->pos);
+                t3d_vec3_scale(&sb.pos, move_b, t);
+                t3d_vec3_add(&sb.pos, &sb.pos, &b->pos);
+
+                /*
+                 * Already overlapping at the start isn't an impact, it's
+                 * up to the caller to separate them.
+                 */
+                if (gjk_distance(res, &sa, &sb)) {
+                        if (!iter)
+                                return false;
+
+                        break;
+                }
+
+                /* Moving apart, or sliding along the surface. */
+                closing = t3d_vec3_dot(&vel, &res->normal);
+                if (closing <= GJK_TOI_CLOSING_MIN)
+                        return false;
+
+                if (res->distance <= GJK_TOI_TOLERANCE)
+                        break;
+
+                t += (res->distance - GJK_TOI_TOLERANCE * .5f) / closing;
+                if (t > 1.f)
+                        return false;
+        }
+
+        /* Ran out of iterations still short of contact. */
+        if (!res->intersecting && res->distance > GJK_TOI_TOLERANCE)
+                return false;
+
+        *toi = t;
+
+        return true;
+}
@@ -0,0 +1,58 @@
+#ifndef GJK_H
+#define GJK_H
+
+#include <stdbool.h>
+
+#include "shape.h"
+
+#define GJK_ITER_MAX 32
+#define GJK_EPS_REL 1e-4f
+#define GJK_EPS_ABS 1e-8f
+
+#define GJK_TOI_ITER_MAX 16
+#define GJK_TOI_TOLERANCE .005f
+#define GJK_TOI_CLOSING_MIN 1e-5f
+
+struct gjk_vertex {
+        T3DVec3 a;
+        T3DVec3 b;
+        T3DVec3 w; /* a - b */
+};
+
+struct gjk_simplex {
+        struct gjk_vertex v[4];
+        float bc[4];
+        int cnt;
+};
+
+struct gjk_result {
+        T3DVec3 point_a;
+        T3DVec3 point_b;
+        T3DVec3 normal; /* From A towards B */
+        float distance;
+        bool intersecting;
+};
+
+/* Carried between queries on the same pair to seed the next search. */
+struct gjk_cache {
+        T3DVec3 normal;
+        bool valid;
+};
+
+void gjk_support(struct gjk_vertex *out, const struct shape *a,
+                 const struct shape *b, const T3DVec3 *dir);
+bool gjk_distance_simplex(struct gjk_result *res, struct gjk_simplex *sp,
+                          const struct shape *a, const struct shape *b);
+bool gjk_distance_cached(struct gjk_result *res, struct gjk_simplex *sp,
+                         const struct shape *a, const struct shape *b,
+                         struct gjk_cache *cache);
+bool gjk_distance(struct gjk_result *res, const struct shape *a,
+                  const struct shape *b);
+bool gjk_time_of_impact(float *toi, struct gjk_result *res,
+                        const struct shape *a, const T3DVec3 *move_a,
+                        const struct shape *b, const T3DVec3 *move_b);
+#ifdef COLLISION_FIXED_POINT
+bool gjk_fixed_may_touch(const struct shape *a, const struct shape *b);
+#endif
+
+#endif /* GJK_H */
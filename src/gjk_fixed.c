@@ -0,0 +1,393 @@
+#ifdef COLLISION_FIXED_POINT
+
+#include <libdragon.h>
+
+#include "gjk_fixed.h"
+
+/*
+ * Same algorithm as gjk.c, on quantised hull vertices only. Dot products
+ * and areas are kept 32.32 until they're turned into barycentric weights,
+ * so the only divides are in fx_ratio() and nothing touches the FPU.
+ */
+
+struct gjk_fixed_vertex {
+        struct fx_vec3 a;
+        struct fx_vec3 b;
+        struct fx_vec3 w; /* a - b */
+};
+
+struct gjk_fixed_simplex {
+        struct gjk_fixed_vertex v[4];
+        fixed32 bc[4];
+        int cnt;
+};
+
+bool fx_aabb_overlap(const struct fx_aabb *a, const struct fx_vec3 *pos_a,
+                     const struct fx_aabb *b, const struct fx_vec3 *pos_b)
+{
+        for (int i = 0; i < 3; ++i) {
+                if (a->min.v[i] + pos_a->v[i] > b->max.v[i] + pos_b->v[i])
+                        return false;
+
+                if (a->max.v[i] + pos_a->v[i] < b->min.v[i] + pos_b->v[i])
+                        return false;
+        }
+
+        return true;
+}
+
+void gjk_fixed_support(struct fx_vec3 *out, const struct collision_hull *h,
+                       const struct fx_vec3 *dir)
+{
+        fixed64 best;
+
+        best = INT64_MIN;
+        *out = (struct fx_vec3){{0, 0, 0}};
+        for (uint32_t i = 0; i < h->vert_cnt_fx; ++i) {
+                fixed64 d;
+
+                d = fx_vec3_dot(h->verts_fx + i, dir);
+                if (d > best) {
+                        best = d;
+                        *out = h->verts_fx[i];
+                }
+        }
+}
+
+static void gjk_fixed_support_pair(struct gjk_fixed_vertex *out,
+                                   const struct collision_hull *a,
+                                   const struct fx_vec3 *pos_a,
+                                   const struct collision_hull *b,
+                                   const struct fx_vec3 *pos_b,
+                                   const struct fx_vec3 *dir)
+{
+        struct fx_vec3 dir_neg;
+
+        for (int i = 0; i < 3; ++i)
+                dir_neg.v[i] = -dir->v[i];
+
+        gjk_fixed_support(&out->a, a, dir);
+        gjk_fixed_support(&out->b, b, &dir_neg);
+        fx_vec3_add(&out->a, &out->a, pos_a);
+        fx_vec3_add(&out->b, &out->b, pos_b);
+        fx_vec3_diff(&out->w, &out->a, &out->b);
+}
+
+static void gjk_fixed_set_point(struct gjk_fixed_simplex *s,
+                                const struct gjk_fixed_vertex *a)
+{
+        s->v[0] = *a;
+        s->bc[0] = FX_ONE;
+        s->cnt = 1;
+}
+
+static void gjk_fixed_set_segment(struct gjk_fixed_simplex *s,
+                                  const struct gjk_fixed_vertex *a,
+                                  const struct gjk_fixed_vertex *b,
+                                  const fixed32 t)
+{
+        struct gjk_fixed_vertex va, vb;
+
+        va = *a;
+        vb = *b;
+        s->v[0] = va;
+        s->v[1] = vb;
+        s->bc[0] = FX_ONE - t;
+        s->bc[1] = t;
+        s->cnt = 2;
+}
+
+static void gjk_fixed_get_point(struct fx_vec3 *out,
+                                const struct gjk_fixed_simplex *s)
+{
+        *out = (struct fx_vec3){{0, 0, 0}};
+        for (int i = 0; i < s->cnt; ++i) {
+                struct fx_vec3 tmp;
+
+                fx_vec3_scale(&tmp, &s->v[i].w, s->bc[i]);
+                fx_vec3_add(out, out, &tmp);
+        }
+}
+
+static fixed64 gjk_fixed_get_dist2(const struct gjk_fixed_simplex *s)
+{
+        struct fx_vec3 p;
+
+        gjk_fixed_get_point(&p, s);
+
+        return fx_vec3_dot(&p, &p);
+}
+
+static void gjk_fixed_closest_segment(struct gjk_fixed_simplex *out,
+                                      const struct gjk_fixed_vertex *a,
+                                      const struct gjk_fixed_vertex *b)
+{
+        struct fx_vec3 ab;
+        fixed64 t, ab_len2;
+
+        fx_vec3_diff(&ab, &b->w, &a->w);
+        t = -fx_vec3_dot(&a->w, &ab);
+        if (t <= 0) {
+                gjk_fixed_set_point(out, a);
+                return;
+        }
+
+        ab_len2 = fx_vec3_dot(&ab, &ab);
+        if (t >= ab_len2) {
+                gjk_fixed_set_point(out, b);
+                return;
+        }
+
+        gjk_fixed_set_segment(out, a, b, fx_ratio(t, ab_len2));
+}
+
+static void gjk_fixed_closest_triangle(struct gjk_fixed_simplex *out,
+                                       const struct gjk_fixed_vertex *a,
+                                       const struct gjk_fixed_vertex *b,
+                                       const struct gjk_fixed_vertex *c)
+{
+        struct gjk_fixed_vertex va, vb, vc;
+        struct fx_vec3 ab, ac;
+        fixed64 d1, d2, d3, d4, d5, d6;
+        fixed64 area_a, area_b, area_c, denom;
+
+        va = *a;
+        vb = *b;
+        vc = *c;
+        fx_vec3_diff(&ab, &vb.w, &va.w);
+        fx_vec3_diff(&ac, &vc.w, &va.w);
+
+        /* 16.16, so the area products below fit in 32.32. */
+        d1 = -fx_vec3_dot(&ab, &va.w) >> FX_SHIFT;
+        d2 = -fx_vec3_dot(&ac, &va.w) >> FX_SHIFT;
+        if (d1 <= 0 && d2 <= 0) {
+                gjk_fixed_set_point(out, &va);
+                return;
+        }
+
+        d3 = -fx_vec3_dot(&ab, &vb.w) >> FX_SHIFT;
+        d4 = -fx_vec3_dot(&ac, &vb.w) >> FX_SHIFT;
+        if (d3 >= 0 && d4 <= d3) {
+                gjk_fixed_set_point(out, &vb);
+                return;
+        }
+
+        area_c = d1 * d4 - d3 * d2;
+        if (area_c <= 0 && d1 >= 0 && d3 <= 0) {
+                gjk_fixed_set_segment(out, &va, &vb, fx_ratio(d1, d1 - d3));
+                return;
+        }
+
+        d5 = -fx_vec3_dot(&ab, &vc.w) >> FX_SHIFT;
+        d6 = -fx_vec3_dot(&ac, &vc.w) >> FX_SHIFT;
+        if (d6 >= 0 && d5 <= d6) {
+                gjk_fixed_set_point(out, &vc);
+                return;
+        }
+
+        area_b = d5 * d2 - d1 * d6;
+        if (area_b <= 0 && d2 >= 0 && d6 <= 0) {
+                gjk_fixed_set_segment(out, &va, &vc, fx_ratio(d2, d2 - d6));
+                return;
+        }
+
+        area_a = d3 * d6 - d5 * d4;
+        if (area_a <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+                gjk_fixed_set_segment(out, &vb, &vc,
+                                      fx_ratio(d4 - d3,
+                                               (d4 - d3) + (d5 - d6)));
+                return;
+        }
+
+        denom = area_a + area_b + area_c;
+        if (denom <= 0) {
+                struct gjk_fixed_simplex s_ab, s_ac, s_bc;
+                fixed64 d_ab, d_ac, d_bc;
+
+                gjk_fixed_closest_segment(&s_ab, &va, &vb);
+                gjk_fixed_closest_segment(&s_ac, &va, &vc);
+                gjk_fixed_closest_segment(&s_bc, &vb, &vc);
+                d_ab = gjk_fixed_get_dist2(&s_ab);
+                d_ac = gjk_fixed_get_dist2(&s_ac);
+                d_bc = gjk_fixed_get_dist2(&s_bc);
+                if (d_ab <= d_ac && d_ab <= d_bc)
+                        *out = s_ab;
+                else if (d_ac <= d_bc)
+                        *out = s_ac;
+                else
+                        *out = s_bc;
+
+                return;
+        }
+
+        out->v[0] = va;
+        out->v[1] = vb;
+        out->v[2] = vc;
+        out->bc[1] = fx_ratio((area_b > 0) ? area_b : 0, denom);
+        out->bc[2] = fx_ratio((area_c > 0) ? area_c : 0, denom);
+        out->bc[0] = FX_ONE - out->bc[1] - out->bc[2];
+        out->cnt = 3;
+}
+
+static bool gjk_fixed_origin_outside_plane(const struct fx_vec3 *a,
+                                           const struct fx_vec3 *b,
+                                           const struct fx_vec3 *c,
+                                           const struct fx_vec3 *d)
+{
+        struct fx_vec3 ab, ac, ad, n;
+        fixed64 sign_o, sign_d;
+
+        fx_vec3_diff(&ab, b, a);
+        fx_vec3_diff(&ac, c, a);
+        fx_vec3_diff(&ad, d, a);
+        fx_vec3_cross(&n, &ab, &ac);
+        sign_o = -fx_vec3_dot(a, &n);
+        sign_d = fx_vec3_dot(&ad, &n);
+
+        if (!sign_d)
+                return true;
+
+        /* Compare signs, the product itself won't fit. */
+        return sign_o && ((sign_o < 0) != (sign_d < 0));
+}
+
+static bool gjk_fixed_closest_tetrahedron(struct gjk_fixed_simplex *s)
+{
+        static const int faces[4][4] = {
+                {0, 1, 2, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {1, 3, 2, 0}
+        };
+        struct gjk_fixed_simplex best;
+        fixed64 best_dist2;
+        bool outside;
+
+        outside = false;
+        best_dist2 = INT64_MAX;
+        for (int i = 0; i < 4; ++i) {
+                const struct gjk_fixed_vertex *a, *b, *c, *d;
+                struct gjk_fixed_simplex cand;
+                fixed64 dist2;
+
+                a = s->v + faces[i][0];
+                b = s->v + faces[i][1];
+                c = s->v + faces[i][2];
+                d = s->v + faces[i][3];
+                if (!gjk_fixed_origin_outside_plane(&a->w, &b->w, &c->w,
+                                                    &d->w))
+                        continue;
+
+                outside = true;
+                gjk_fixed_closest_triangle(&cand, a, b, c);
+                dist2 = gjk_fixed_get_dist2(&cand);
+                if (dist2 < best_dist2) {
+                        best_dist2 = dist2;
+                        best = cand;
+                }
+        }
+
+        if (!outside)
+                return true;
+
+        *s = best;
+
+        return false;
+}
+
+static bool gjk_fixed_simplex_solve(struct gjk_fixed_simplex *s)
+{
+        switch (s->cnt) {
+                case 2:
+                        gjk_fixed_closest_segment(s, s->v + 0, s->v + 1);
+                        return false;
+
+                case 3:
+                        gjk_fixed_closest_triangle(s, s->v + 0, s->v + 1,
+                                                   s->v + 2);
+                        return false;
+
+                case 4:
+                        return gjk_fixed_closest_tetrahedron(s);
+
+                default:
+                        return false;
+        }
+}
+
+bool gjk_fixed_distance(struct gjk_fixed_result *res,
+                        const struct collision_hull *a,
+                        const struct fx_vec3 *pos_a,
+                        const struct collision_hull *b,
+                        const struct fx_vec3 *pos_b)
+{
+        struct gjk_fixed_simplex s;
+        struct fx_vec3 v, dir;
+        fixed64 dist2;
+
+        res->intersecting = false;
+
+        fx_vec3_diff(&dir, pos_b, pos_a);
+        if (!dir.v[0] && !dir.v[1] && !dir.v[2])
+                dir.v[0] = FX_ONE;
+
+        gjk_fixed_support_pair(s.v + 0, a, pos_a, b, pos_b, &dir);
+        s.bc[0] = FX_ONE;
+        s.cnt = 1;
+        v = s.v[0].w;
+        dist2 = fx_vec3_dot(&v, &v);
+
+        for (int iter = 0; iter < GJK_FIXED_ITER_MAX; ++iter) {
+                struct gjk_fixed_vertex w;
+                fixed64 dist2_prev;
+                bool dup;
+
+                if (dist2 <= GJK_FIXED_EPS_ABS) {
+                        res->intersecting = true;
+                        break;
+                }
+
+                for (int i = 0; i < 3; ++i)
+                        dir.v[i] = -v.v[i];
+
+                gjk_fixed_support_pair(&w, a, pos_a, b, pos_b, &dir);
+                if (dist2 - fx_vec3_dot(&v, &w.w) <=
+                    (dist2 >> GJK_FIXED_EPS_REL_SHIFT))
+                        break;
+
+                dup = false;
+                for (int i = 0; i < s.cnt; ++i)
+                        dup |= !memcmp(&s.v[i].w, &w.w, sizeof(w.w));
+
+                if (dup)
+                        break;
+
+                s.v[s.cnt++] = w;
+                if (gjk_fixed_simplex_solve(&s)) {
+                        res->intersecting = true;
+                        break;
+                }
+
+                dist2_prev = dist2;
+                gjk_fixed_get_point(&v, &s);
+                dist2 = fx_vec3_dot(&v, &v);
+                if (dist2 >= dist2_prev)
+                        break;
+        }
+
+        res->point_a = (struct fx_vec3){{0, 0, 0}};
+        res->point_b = (struct fx_vec3){{0, 0, 0}};
+        if (s.cnt < 4) {
+                for (int i = 0; i < s.cnt; ++i) {
+                        struct fx_vec3 tmp;
+
+                        fx_vec3_scale(&tmp, &s.v[i].a, s.bc[i]);
+                        fx_vec3_add(&res->point_a, &res->point_a, &tmp);
+                        fx_vec3_scale(&tmp, &s.v[i].b, s.bc[i]);
+                        fx_vec3_add(&res->point_b, &res->point_b, &tmp);
+                }
+        }
+
+        res->distance = (res->intersecting) ? 0 : fx_sqrt_wide(dist2);
+
+        return res->intersecting;
+}
+
+#endif /* COLLISION_FIXED_POINT */
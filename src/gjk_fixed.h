@@ -0,0 +1,34 @@
+#ifndef GJK_FIXED_H
+#define GJK_FIXED_H
+
+#ifdef COLLISION_FIXED_POINT
+
+#include <stdbool.h>
+
+#include "collision.h"
+#include "fixed.h"
+
+#define GJK_FIXED_ITER_MAX 32
+#define GJK_FIXED_EPS_REL_SHIFT 13 /* ~1e-4, as GJK_EPS_REL */
+#define GJK_FIXED_EPS_ABS 64 /* 32.32, ~1e-8 as GJK_EPS_ABS */
+
+struct gjk_fixed_result {
+        struct fx_vec3 point_a;
+        struct fx_vec3 point_b;
+        fixed32 distance;
+        bool intersecting;
+};
+
+bool fx_aabb_overlap(const struct fx_aabb *a, const struct fx_vec3 *pos_a,
+                     const struct fx_aabb *b, const struct fx_vec3 *pos_b);
+void gjk_fixed_support(struct fx_vec3 *out, const struct collision_hull *h,
+                       const struct fx_vec3 *dir);
+bool gjk_fixed_distance(struct gjk_fixed_result *res,
+                        const struct collision_hull *a,
+                        const struct fx_vec3 *pos_a,
+                        const struct collision_hull *b,
+                        const struct fx_vec3 *pos_b);
+
+#endif /* COLLISION_FIXED_POINT */
+
+#endif /* GJK_FIXED_H */
@@ -4,6 +4,14 @@
 #include <t3d/t3ddebug.h>
 #include <t3d/tpx.h>
 
+#include "arena.h"
+#include "bench.h"
+#include "collision.h"
+#include "gjk.h"
+#include "narrowphase.h"
+#include "shape_cast.h"
+#include "world.h"
+
 #define VIEWPORT_NEAR (.25f * MODEL_SCALE)
 #define VIEWPORT_FAR (10.f * MODEL_SCALE)
 #define VIEWPORT_FOV_DEG 75.f
@@ -15,6 +23,10 @@
 #define OBSERVER_NOCLIP_SPEED_FAST 12.2f
 
 #define OBJECT_MOVE_SPEED 16.f
+#define OBJECT_SLIDE_ITER_MAX 3
+
+#define LEVEL_ARENA_SIZE (64 * 1024)
+#define SCRATCH_ARENA_SIZE (16 * 1024)
 
 #define JOYSTICK_MAG_MAX 60
 #define JOYSTICK_MAG_MIN 6
@@ -64,75 +76,79 @@ static float get_normalized_stick(float *out, const int8_t stick_in_x,
         return mag;
 }
 
-struct collision_triangle {
-        T3DVec3 pos[3];
-};
-
-struct collision_data {
-        uint32_t tri_cnt;
-        struct collision_triangle *tris;
-};
-
 struct object {
         struct collision_data col_dat;
+        struct shape *shapes; /* Each hull, then each static triangle */
+        int shape_cnt;
         T3DModel *mdl;
         T3DMat4FP *mtx;
         rspq_block_t *dl;
         T3DVec3 pos_a;
         T3DVec3 pos_b;
+        int body_first; /* Kinematic, in the world, one per shape */
+        int body_cnt;
 };
 
-struct collision_data object_get_collision_data(const char *path)
-{
-        struct collision_data cd;
-        FILE *f;
-        
-        f = asset_fopen(path, NULL);
-
-        fread(&cd.tri_cnt, 4, 1, f);
-        cd.tris = malloc(sizeof(*cd.tris) * cd.tri_cnt);
-        for (uint32_t i = 0; i < cd.tri_cnt; ++i) {
-                struct collision_triangle *t;
-
-                t = cd.tris + i;
-                for (int j = 0; j < 3; ++j)
-                        for (int k = 0; k < 3; ++k)
-                                fread(t->pos[j].v + k, 4, 1, f);
-        }
-
-        fclose(f);
-
-        return cd;
-}
-
-static char *path_replace_extension(const char *in, const char *new_ext)
+static char *path_replace_extension(const char *in, const char *new_ext,
+                                    struct arena *ar)
 {
         char *out;
-        int out_len_old, out_len;
-        int new_ext_len;
+        int stem_len, new_ext_len;
 
-        out_len = (int)(strrchr(in, '.') - in);
-        out = malloc(out_len + 1);
-        out[out_len] = 0;
-        memcpy(out, in, out_len);
+        stem_len = (int)(strrchr(in, '.') - in);
         new_ext_len = strlen(new_ext);
-        out_len_old = out_len;
-        out_len += new_ext_len;
-        out = realloc(out, out_len + 1);
-        out[out_len] = 0;
-        snprintf(out + out_len_old, out_len, ".%s", new_ext);
+        out = arena_alloc(ar, stem_len + new_ext_len + 2);
+        memcpy(out, in, stem_len);
+        snprintf(out + stem_len, new_ext_len + 2, ".%s", new_ext);
 
         return out;
 }
 
-static struct object object_create(const char *path, const T3DVec3 *start_pos)
+/*
+ * Convex pieces collide as hulls, the static rest one triangle at a time,
+ * which is all a concave mesh can collide as.
+ */
+static void object_make_shapes(struct object *o, struct arena *level)
+{
+        const struct collision_data *cd;
+
+        cd = &o->col_dat;
+        o->shape_cnt = cd->hull_cnt;
+        for (uint32_t i = 0; i < cd->piece_cnt; ++i)
+                if (!(cd->pieces[i].flags & COLLISION_PIECE_CONVEX))
+                        o->shape_cnt += cd->pieces[i].cnt;
+
+        o->shapes = arena_alloc(level, sizeof(*o->shapes) * o->shape_cnt);
+        o->shape_cnt = 0;
+        for (uint32_t i = 0; i < cd->hull_cnt; ++i)
+                o->shapes[o->shape_cnt++] = shape_make_hull(cd->hulls + i,
+                                                            &o->pos_b);
+
+        for (uint32_t i = 0; i < cd->piece_cnt; ++i) {
+                const struct collision_piece *p;
+
+                p = cd->pieces + i;
+                if (p->flags & COLLISION_PIECE_CONVEX)
+                        continue;
+
+                for (uint32_t j = p->first; j < p->first + p->cnt; ++j)
+                        o->shapes[o->shape_cnt++] =
+                                shape_make_triangle(cd->tris + j, &o->pos_b);
+        }
+}
+
+/* Collision data lives in `level`, `scratch` is only borrowed. */
+static struct object object_create(const char *path, const T3DVec3 *start_pos,
+                                   struct arena *level, struct arena *scratch)
 {
         struct object o;
         char *path_cm;
+        size_t mark;
 
-        path_cm = path_replace_extension(path, "cm");
-        o.col_dat = object_get_collision_data(path_cm);
-        free(path_cm);
+        mark = arena_mark(scratch);
+        path_cm = path_replace_extension(path, "cm", scratch);
+        o.col_dat = collision_data_load(path_cm, level, scratch);
+        arena_reset(scratch, mark);
 
         o.mdl = t3d_model_load(path);
         o.mtx = malloc_uncached(sizeof(*o.mtx));
@@ -145,6 +161,9 @@ static struct object object_create(const char *path, const T3DVec3 *start_pos)
 
         o.pos_a = (start_pos) ? *start_pos : (T3DVec3){{0.f, 0.f, 0.f}};
         o.pos_b = o.pos_a;
+        object_make_shapes(&o, level);
+        o.body_first = -1;
+        o.body_cnt = 0;
 
         return o;
 }
@@ -154,10 +173,6 @@ static void object_destroy(struct object *o)
         rspq_block_free(o->dl);
         free_uncached(o->mtx);
         t3d_model_free(o->mdl);
-        if (o->col_dat.tri_cnt || o->col_dat.tris) {
-                o->col_dat.tri_cnt = 0;
-                free(o->col_dat.tris);
-        }
 }
 
 static void object_render(const struct object *o, const float st)
@@ -336,7 +351,38 @@ static const char *mode_enum_to_string(const enum mode m)
         }
 }
 
+static void object_set_pos(struct object *o, const T3DVec3 *pos)
+{
+        o->pos_b = *pos;
+        for (int i = 0; i < o->shape_cnt; ++i)
+                o->shapes[i].pos = *pos;
+}
+
+/*
+ * Sweeps every shape of `o` against every shape of `other` that can be
+ * told apart from a wall, so triangle against triangle is skipped. All of
+ * an object's shapes share its position, so they can share one cast.
+ */
+static void object_cast(struct shape_cast_hit *hit, const struct object *o,
+                        const T3DVec3 *move, const struct object *other)
+{
+        for (int i = 0; i < o->shape_cnt; ++i) {
+                const struct shape *caster;
+
+                caster = o->shapes + i;
+                for (uint32_t j = 0; j < other->col_dat.hull_cnt; ++j)
+                        shape_cast_shape(hit, caster, move, other->shapes + j);
+
+                if (caster->type == SHAPE_HULL)
+                        shape_cast_mesh(hit, caster, move, &other->col_dat,
+                                        &other->pos_b);
+        }
+}
+
 static void object_move(struct object *o,
+                        const struct object *objs,
+                        const int obj_cnt,
+                        struct world *w,
                         const joypad_inputs_t *inp,
                         const float ft)
 {
@@ -349,12 +395,43 @@ static void object_move(struct object *o,
         t3d_vec3_scale(&move, &move, OBJECT_MOVE_SPEED * ft);
 
         o->pos_a = o->pos_b;
-        t3d_vec3_add(&o->pos_b, &o->pos_b, &move);
+
+        /* Nothing to sweep with, so nothing to stop it either. */
+        if (!o->shape_cnt) {
+                t3d_vec3_add(&move, &o->pos_b, &move);
+                object_set_pos(o, &move);
+                return;
+        }
+
+        /* Sweep against everything else, sliding along whatever we hit. */
+        for (int iter = 0; iter < OBJECT_SLIDE_ITER_MAX; ++iter) {
+                struct shape_cast_hit hit;
+                T3DVec3 move_into;
+
+                shape_cast_init(&hit, o->shapes, &move);
+                for (int i = 0; i < obj_cnt; ++i)
+                        if (objs + i != o)
+                                object_cast(&hit, o, &move, objs + i);
+
+                object_set_pos(o, &hit.safe_pos);
+                if (!hit.hit)
+                        break;
+
+                t3d_vec3_scale(&move, &move, 1.f - hit.fraction);
+                t3d_vec3_scale(&move_into, &hit.normal,
+                               t3d_vec3_dot(&move, &hit.normal));
+                t3d_vec3_diff(&move, &move, &move_into);
+        }
+
+        /* Wakes whatever it was resting against. */
+        for (int i = 0; i < o->body_cnt; ++i)
+                world_set_body_pos(w, o->body_first + i, &o->pos_b);
 }
 
 static enum mode update_depending_on_mode(enum mode m,
                                           struct observer *obs,
                                           struct object *objs,
+                                          struct world *w,
                                           const joypad_inputs_t *inp_new,
                                           const joypad_inputs_t *inp_old,
                                           const float ft)
@@ -370,20 +447,116 @@ static enum mode update_depending_on_mode(enum mode m,
         if (m < MODE_MOVE_OBJ_A) 
                 observer_update(obs, inp_new, ft);
         else
-                object_move(objs + m - 1, inp_new, ft);
+                object_move(objs + m - 1, objs, OBJ_COUNT, w, inp_new,
+                            ft);
 
         return m;
 }
 
+/* Bodies are added in a run, stopping short if the world fills up. */
+static void object_add_to_world(struct object *o, struct world *w)
+{
+        for (int i = 0; i < o->shape_cnt; ++i) {
+                struct body b;
+                int ind;
+
+                b = body_make(o->shapes + i, 0.f);
+                ind = world_add_body(w, &b);
+                if (ind < 0)
+                        break;
+
+                if (!o->body_cnt)
+                        o->body_first = ind;
+
+                ++o->body_cnt;
+        }
+}
+
 #define DBG_Y_POS (32 + (line++ * 10))
-static void render_debug_info(const enum mode mode)
+#ifdef DEBUG
+/*
+ * Closest and deepest over every shape pair but wall on wall. The world
+ * never collides two kinematic bodies, so this runs the narrowphase itself,
+ * once per pair per frame, which only debug builds pay for. Returns the
+ * line after its own.
+ */
+static int render_debug_objects(const struct object *a,
+                                const struct object *b, int line)
 {
+        struct gjk_result res;
+        struct contact c;
+        float dist, depth;
+        T3DVec3 normal;
+        bool hit;
+
+        dist = INFINITY;
+        depth = -INFINITY;
+        normal = (T3DVec3){{0.f, 0.f, 0.f}};
+        hit = false;
+        for (int i = 0; i < a->shape_cnt; ++i) {
+                for (int j = 0; j < b->shape_cnt; ++j) {
+                        if (a->shapes[i].type == SHAPE_TRIANGLE &&
+                            b->shapes[j].type == SHAPE_TRIANGLE)
+                                continue;
+
+                        gjk_distance(&res, a->shapes + i, b->shapes + j);
+                        dist = fminf(dist, res.distance);
+                        hit |= res.intersecting;
+                        if (narrowphase_collide(&c, a->shapes + i,
+                                                b->shapes + j) &&
+                            c.depth > depth) {
+                                depth = c.depth;
+                                normal = c.normal;
+                        }
+                }
+        }
+
+        t3d_debug_printf(32, DBG_Y_POS, "Distance: %.3f%s", dist,
+                         (hit) ? " (HIT)" : "");
+        if (depth > -INFINITY)
+                t3d_debug_printf(32, DBG_Y_POS, "Depth: %.3f (%.2f %.2f %.2f)",
+                                 depth, normal.v[0], normal.v[1],
+                                 normal.v[2]);
+
+        return line;
+}
+#endif
+
+static void render_debug_info(const enum mode mode,
+                              const struct object *objs,
+                              const struct world *w)
+{
+        const struct {
+                const char *name;
+                const struct pool *p;
+        } pools[] = {
+                {"Pairs", &w->pairs},
+                {"Caches", world_get_caches(w)},
+                {"Contacts", &w->contacts}
+        };
         int line;
 
         line = 0;
         t3d_debug_print_start();
         t3d_debug_printf(32, DBG_Y_POS, "Mode: %s (%d)",
                          mode_enum_to_string(mode), mode);
+
+#ifdef DEBUG
+        line = render_debug_objects(objs + OBJ_A, objs + OBJ_B, line);
+#else
+        (void)objs;
+#endif
+
+        /* Live / capacity, peak, and anything refused this tick. */
+        for (size_t i = 0; i < sizeof(pools) / sizeof(*pools); ++i)
+                t3d_debug_printf(32, DBG_Y_POS, "%s: %lu/%lu max %lu%s",
+                                 pools[i].name, pools[i].p->cnt,
+                                 pools[i].p->cap, pools[i].p->high_water,
+                                 (pools[i].p->dropped) ? " FULL" : "");
+
+        t3d_debug_printf(32, DBG_Y_POS, "Awake: %u/%u",
+                         world_get_awake_cnt(w), w->body_cnt);
+
         if (mode < MODE_MOVE_OBJ_A)
                 return;
 
@@ -391,12 +564,10 @@ static void render_debug_info(const enum mode mode)
 }
 #undef DBG_Y_POS
 
+/* `diffs` holds `part_cnt` vectors, too many for any fixed scratch. */
 static void particles_update_from_objs(const int part_cnt, TPXParticle *parts,
-                                       struct object *objs)
+                                       T3DVec3 *diffs, struct object *objs)
 {
-        T3DVec3 *diffs;
-
-        diffs = malloc(sizeof(*diffs) * part_cnt);
         for (uint32_t y = 0; y < objs[OBJ_A].col_dat.tri_cnt; ++y) {
                 for (uint32_t x = 0; x < objs[OBJ_B].col_dat.tri_cnt; ++x) {
                         T3DVec3 *a, *b;
@@ -439,8 +610,6 @@ static void particles_update_from_objs(const int part_cnt, TPXParticle *parts,
                 p->colorB[2] = 0xFF;
                 p->colorB[3] = 0xFF;
         }
-
-        free(diffs);
 }
 
 int main(void)
@@ -452,8 +621,11 @@ int main(void)
 
         T3DMat4FP *particle_mtx;
         TPXParticle *particles;
+        T3DVec3 *particle_diffs;
         uint32_t particle_count;
 
+        struct arena level_arena, scratch_arena;
+        struct world world;
         struct observer observer;
         struct object objs[OBJ_COUNT];
         enum mode mode;
@@ -482,11 +654,19 @@ int main(void)
         viewport = t3d_viewport_create();
 
         /* Initialize Simulation */
+        level_arena = arena_create(LEVEL_ARENA_SIZE);
+        scratch_arena = arena_create(SCRATCH_ARENA_SIZE);
         observer = observer_init();
         objs[OBJ_A] = object_create("rom:/obj_a.t3dm",
-                                    &(T3DVec3){{1.f, 0.f, 0.f}});
+                                    &(T3DVec3){{1.f, 0.f, 0.f}},
+                                    &level_arena, &scratch_arena);
         objs[OBJ_B] = object_create("rom:/obj_b.t3dm",
-                                    &(T3DVec3){{-1.f, 0.f, 0.f}});
+                                    &(T3DVec3){{-1.f, 0.f, 0.f}},
+                                    &level_arena, &scratch_arena);
+        world = world_create(&WORLD_CONFIG_DEFAULT, &level_arena);
+        for (int i = 0; i < OBJ_COUNT; ++i)
+                object_add_to_world(objs + i, &world);
+
         mode = MODE_OBSERVER;
 
         /* Initialize TPX (particles) */
@@ -496,6 +676,7 @@ int main(void)
                          (objs[OBJ_B].col_dat.tri_cnt * 3);
         debugf("particle_count: %lu\n", particle_count);
         particles = malloc_uncached(sizeof(*particles) * (particle_count >> 1));
+        particle_diffs = malloc(sizeof(*particle_diffs) * particle_count);
 
         /* Main loop. */
         time_accumulated = 0.f;
@@ -513,8 +694,27 @@ int main(void)
                         inp_new = joypad_get_inputs(JOYPAD_PORT_1);
 
                         mode = update_depending_on_mode(mode, &observer, objs,
-                                                        &inp_new, &inp_old,
-                                                        fixed_time);
+                                                        &world, &inp_new,
+                                                        &inp_old, fixed_time);
+                        world_step(&world, fixed_time);
+#ifdef DEBUG
+                        if (inp_new.btn.start && !inp_old.btn.start) {
+                                const struct collision_hull
+                                        *hulls[BENCH_HULL_MAX];
+                                int hull_cnt;
+
+                                hull_cnt = 0;
+                                for (int i = 0; i < OBJ_COUNT; ++i)
+                                        for (uint32_t j = 0;
+                                             j < objs[i].col_dat.hull_cnt &&
+                                             hull_cnt < BENCH_HULL_MAX; ++j)
+                                                hulls[hull_cnt++] =
+                                                        objs[i].col_dat.hulls +
+                                                        j;
+
+                                bench_run(hulls, hull_cnt);
+                        }
+#endif
                 }
 
                 /* Rendering Setup */
@@ -554,12 +754,13 @@ int main(void)
                 tpx_state_from_t3d();
                 tpx_matrix_push(particle_mtx);
                 tpx_state_set_scale(1.f, 1.f);
-                particles_update_from_objs(particle_count, particles, objs);
+                particles_update_from_objs(particle_count, particles,
+                                           particle_diffs, objs);
                 tpx_particle_draw(particles, particle_count);
                 tpx_matrix_pop(1);
 
                 /* UI Rendering */
-                render_debug_info(mode);
+                render_debug_info(mode, objs, &world);
                 rdpq_detach_show();
         }
 
@@ -567,7 +768,11 @@ int main(void)
         for (int i = 0; i < OBJ_COUNT; ++i)
                 object_destroy(objs + i);
 
+        arena_destroy(&scratch_arena);
+        arena_destroy(&level_arena);
+
         /* Terminate TPX */
+        free(particle_diffs);
         free_uncached(particles);
         free_uncached(particle_mtx);
         tpx_destroy();
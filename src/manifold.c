@@ -0,0 +1,274 @@
+#include <libdragon.h>
+
+#include "manifold.h"
+
+void manifold_init(struct manifold *m)
+{
+        m->normal = (T3DVec3){{0.f, 0.f, 1.f}};
+        m->cnt = 0;
+}
+
+void manifold_get_contact(struct contact *out, const struct manifold *m,
+                          const int i, const struct shape *a,
+                          const struct shape *b)
+{
+        shape_point_to_world(&out->point_a, a, &m->pts[i].local_a);
+        shape_point_to_world(&out->point_b, b, &m->pts[i].local_b);
+        out->normal = m->normal;
+        out->depth = m->pts[i].depth;
+}
+
+/*
+ * Re-evaluates every point where the shapes are now, dropping the ones
+ * that have pulled apart along the normal or slid off along the surface.
+ */
+static void manifold_refresh(struct manifold *m, const struct shape *a,
+                             const struct shape *b)
+{
+        for (int i = m->cnt - 1; i >= 0; --i) {
+                struct contact c;
+                T3DVec3 off, drift;
+
+                manifold_get_contact(&c, m, i, a, b);
+                t3d_vec3_diff(&off, &c.point_a, &c.point_b);
+                m->pts[i].depth = t3d_vec3_dot(&off, &m->normal);
+                t3d_vec3_scale(&drift, &m->normal, m->pts[i].depth);
+                t3d_vec3_diff(&drift, &off, &drift);
+                if (m->pts[i].depth >= -MANIFOLD_BREAK_DIST &&
+                    t3d_vec3_len2(&drift) <= MANIFOLD_BREAK_DIST *
+                                             MANIFOLD_BREAK_DIST)
+                        continue;
+
+                m->pts[i] = m->pts[--m->cnt];
+        }
+}
+
+/* Twice the largest diagonal cross product, a cheap stand-in for area. */
+static float manifold_quad_area(const T3DVec3 *p0, const T3DVec3 *p1,
+                                const T3DVec3 *p2, const T3DVec3 *p3)
+{
+        static const int diags[3][4] = {
+                {0, 1, 2, 3}, {0, 2, 1, 3}, {0, 3, 1, 2}
+        };
+        const T3DVec3 *p[4] = {p0, p1, p2, p3};
+        float best;
+
+        best = 0.f;
+        for (int i = 0; i < 3; ++i) {
+                T3DVec3 e0, e1, n;
+                float area;
+
+                t3d_vec3_diff(&e0, p[diags[i][0]], p[diags[i][1]]);
+                t3d_vec3_diff(&e1, p[diags[i][2]], p[diags[i][3]]);
+                t3d_vec3_cross(&n, &e0, &e1);
+                area = t3d_vec3_len2(&n);
+                if (area > best)
+                        best = area;
+        }
+
+        return best;
+}
+
+/*
+ * With one point too many, keep the deepest and drop whichever other
+ * point leaves the widest patch.
+ */
+static void manifold_reduce(struct manifold *m,
+                            const struct manifold_point *extra)
+{
+        struct manifold_point pts[MANIFOLD_POINT_MAX + 1];
+        int deepest, drop;
+        float best_area;
+
+        for (int i = 0; i < MANIFOLD_POINT_MAX; ++i)
+                pts[i] = m->pts[i];
+
+        pts[MANIFOLD_POINT_MAX] = *extra;
+        deepest = 0;
+        for (int i = 1; i <= MANIFOLD_POINT_MAX; ++i)
+                if (pts[i].depth > pts[deepest].depth)
+                        deepest = i;
+
+        drop = -1;
+        best_area = -1.f;
+        for (int i = 0; i <= MANIFOLD_POINT_MAX; ++i) {
+                const T3DVec3 *keep[MANIFOLD_POINT_MAX];
+                float area;
+                int cnt;
+
+                if (i == deepest)
+                        continue;
+
+                cnt = 0;
+                for (int j = 0; j <= MANIFOLD_POINT_MAX; ++j)
+                        if (j != i)
+                                keep[cnt++] = &pts[j].local_a;
+
+                area = manifold_quad_area(keep[0], keep[1], keep[2],
+                                          keep[3]);
+                if (area > best_area) {
+                        best_area = area;
+                        drop = i;
+                }
+        }
+
+        m->cnt = 0;
+        for (int i = 0; i <= MANIFOLD_POINT_MAX; ++i)
+                if (i != drop)
+                        m->pts[m->cnt++] = pts[i];
+}
+
+/*
+ * Folds this tick's narrowphase contact, if any, into the manifold. A new
+ * point close to an old one replaces it, so a resting pair builds up a
+ * stable patch over a few ticks from one query per tick.
+ */
+void manifold_update(struct manifold *m, const struct contact *c,
+                     const struct shape *a, const struct shape *b)
+{
+        struct manifold_point p;
+
+        if (c)
+                m->normal = c->normal;
+
+        manifold_refresh(m, a, b);
+        if (!c)
+                return;
+
+        shape_point_to_local(&p.local_a, a, &c->point_a);
+        shape_point_to_local(&p.local_b, b, &c->point_b);
+        p.depth = c->depth;
+        p.impulse = 0.f;
+        for (int i = 0; i < m->cnt; ++i) {
+                T3DVec3 d;
+
+                t3d_vec3_diff(&d, &m->pts[i].local_a, &p.local_a);
+                if (t3d_vec3_len2(&d) <= MANIFOLD_BREAK_DIST *
+                                         MANIFOLD_BREAK_DIST) {
+                        p.impulse = m->pts[i].impulse;
+                        m->pts[i] = p;
+                        return;
+                }
+        }
+
+        if (m->cnt < MANIFOLD_POINT_MAX) {
+                m->pts[m->cnt++] = p;
+                return;
+        }
+
+        manifold_reduce(m, &p);
+}
+
+/*
+ * Replaces the manifold with a full set of contacts, such as from face
+ * clipping. Past MANIFOLD_POINT_MAX it keeps the deepest, the one furthest
+ * from it, then whichever points span the most area with those. Points
+ * landing where an old one was inherit its impulse.
+ */
+void manifold_set(struct manifold *m, const struct contact *cs,
+                  const int cnt, const struct shape *a,
+                  const struct shape *b)
+{
+        struct manifold_point old[MANIFOLD_POINT_MAX];
+        int keep[MANIFOLD_POINT_MAX];
+        int keep_cnt, old_cnt;
+
+        old_cnt = m->cnt;
+        for (int i = 0; i < old_cnt; ++i)
+                old[i] = m->pts[i];
+
+        m->cnt = 0;
+        if (!cnt)
+                return;
+
+        m->normal = cs[0].normal;
+        keep_cnt = 0;
+        if (cnt <= MANIFOLD_POINT_MAX) {
+                for (int i = 0; i < cnt; ++i)
+                        keep[keep_cnt++] = i;
+        } else {
+                const T3DVec3 *p0, *p1, *p2;
+                float best;
+
+                keep[0] = 0;
+                for (int i = 1; i < cnt; ++i)
+                        if (cs[i].depth > cs[keep[0]].depth)
+                                keep[0] = i;
+
+                p0 = &cs[keep[0]].point_b;
+                keep[1] = keep[0];
+                best = -1.f;
+                for (int i = 0; i < cnt; ++i) {
+                        T3DVec3 d;
+
+                        t3d_vec3_diff(&d, &cs[i].point_b, p0);
+                        if (t3d_vec3_len2(&d) > best) {
+                                best = t3d_vec3_len2(&d);
+                                keep[1] = i;
+                        }
+                }
+
+                p1 = &cs[keep[1]].point_b;
+                keep[2] = keep[0];
+                best = -1.f;
+                for (int i = 0; i < cnt; ++i) {
+                        float area;
+
+                        area = manifold_quad_area(p0, p1, p0,
+                                                  &cs[i].point_b);
+                        if (area > best) {
+                                best = area;
+                                keep[2] = i;
+                        }
+                }
+
+                p2 = &cs[keep[2]].point_b;
+                keep[3] = keep[0];
+                best = -1.f;
+                for (int i = 0; i < cnt; ++i) {
+                        float area;
+
+                        area = manifold_quad_area(p0, p1, p2,
+                                                  &cs[i].point_b);
+                        if (area > best) {
+                                best = area;
+                                keep[3] = i;
+                        }
+                }
+
+                keep_cnt = MANIFOLD_POINT_MAX;
+        }
+
+        for (int i = 0; i < keep_cnt; ++i) {
+                struct manifold_point *p;
+                const struct contact *c;
+                bool dup;
+
+                /* Collinear sets pick the same point more than once. */
+                dup = false;
+                for (int j = 0; j < i && !dup; ++j)
+                        dup = (keep[j] == keep[i]);
+
+                if (dup)
+                        continue;
+
+                c = cs + keep[i];
+                p = m->pts + m->cnt++;
+                shape_point_to_local(&p->local_a, a, &c->point_a);
+                shape_point_to_local(&p->local_b, b, &c->point_b);
+                p->depth = c->depth;
+
+                /* Carry the impulse over from the same spot last tick. */
+                p->impulse = 0.f;
+                for (int j = 0; j < old_cnt; ++j) {
+                        T3DVec3 d;
+
+                        t3d_vec3_diff(&d, &old[j].local_a, &p->local_a);
+                        if (t3d_vec3_len2(&d) <= MANIFOLD_BREAK_DIST *
+                                                 MANIFOLD_BREAK_DIST) {
+                                p->impulse = old[j].impulse;
+                                break;
+                        }
+                }
+        }
+}
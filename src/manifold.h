@@ -0,0 +1,34 @@
+#ifndef MANIFOLD_H
+#define MANIFOLD_H
+
+#include "contact.h"
+#include "shape.h"
+
+#define MANIFOLD_POINT_MAX 4
+#define MANIFOLD_BREAK_DIST .02f /* Separation or drift that drops a point */
+
+/* Anchored in each shape's local frame, so they follow the shapes. */
+struct manifold_point {
+        T3DVec3 local_a;
+        T3DVec3 local_b;
+        float depth;
+        float impulse; /* Solver's accumulated normal impulse, warm start */
+};
+
+struct manifold {
+        struct manifold_point pts[MANIFOLD_POINT_MAX];
+        T3DVec3 normal; /* From A towards B, from the newest contact */
+        int cnt;
+};
+
+void manifold_init(struct manifold *m);
+void manifold_update(struct manifold *m, const struct contact *c,
+                     const struct shape *a, const struct shape *b);
+void manifold_set(struct manifold *m, const struct contact *cs,
+                  const int cnt, const struct shape *a,
+                  const struct shape *b);
+void manifold_get_contact(struct contact *out, const struct manifold *m,
+                          const int i, const struct shape *a,
+                          const struct shape *b);
+
+#endif /* MANIFOLD_H */
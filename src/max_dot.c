@@ -0,0 +1,192 @@
+#include <libdragon.h>
+
+#include "max_dot.h"
+
+#ifdef MAX_DOT_SIMD
+#include <immintrin.h>
+#endif
+
+/*
+ * Index of the point with the greatest dot product with `dir`, over
+ * per-axis arrays of `cnt` points. `cnt` must be a non-zero multiple of
+ * COLLISION_SOA_PAD, which the loader guarantees. Ties go to the lowest
+ * index on every path, so they all agree.
+ */
+uint32_t max_dot_scalar(const float *x, const float *y, const float *z,
+                        const uint32_t cnt, const T3DVec3 *dir)
+{
+        uint32_t best_ind;
+        float best;
+
+        best = -INFINITY;
+        best_ind = 0;
+        for (uint32_t i = 0; i < cnt; ++i) {
+                float d;
+
+                d = x[i] * dir->v[0] + y[i] * dir->v[1] + z[i] * dir->v[2];
+                if (d > best) {
+                        best = d;
+                        best_ind = i;
+                }
+        }
+
+        return best_ind;
+}
+
+#ifdef MAX_DOT_SIMD
+static uint32_t max_dot_reduce(const float *best, const int32_t *best_ind,
+                               const int lane_cnt)
+{
+        int lane;
+
+        lane = 0;
+        for (int i = 1; i < lane_cnt; ++i)
+                if (best[i] > best[lane] ||
+                    (best[i] == best[lane] && best_ind[i] < best_ind[lane]))
+                        lane = i;
+
+        return best_ind[lane];
+}
+
+__attribute__((target("sse4.1")))
+static uint32_t max_dot_sse41(const float *x, const float *y, const float *z,
+                              const uint32_t cnt, const T3DVec3 *dir)
+{
+        __m128 dx, dy, dz, best;
+        __m128i ind, best_ind, step;
+        float best_lane[4];
+        int32_t best_ind_lane[4];
+
+        dx = _mm_set1_ps(dir->v[0]);
+        dy = _mm_set1_ps(dir->v[1]);
+        dz = _mm_set1_ps(dir->v[2]);
+        best = _mm_set1_ps(-INFINITY);
+        best_ind = _mm_setzero_si128();
+        ind = _mm_setr_epi32(0, 1, 2, 3);
+        step = _mm_set1_epi32(4);
+        for (uint32_t i = 0; i < cnt; i += 4) {
+                __m128 d, gt;
+
+                d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), dx),
+                                          _mm_mul_ps(_mm_loadu_ps(y + i), dy)),
+                               _mm_mul_ps(_mm_loadu_ps(z + i), dz));
+                gt = _mm_cmpgt_ps(d, best);
+                best = _mm_blendv_ps(best, d, gt);
+                best_ind = _mm_castps_si128(
+                        _mm_blendv_ps(_mm_castsi128_ps(best_ind),
+                                      _mm_castsi128_ps(ind), gt));
+                ind = _mm_add_epi32(ind, step);
+        }
+
+        _mm_storeu_ps(best_lane, best);
+        _mm_storeu_si128((__m128i *)best_ind_lane, best_ind);
+
+        return max_dot_reduce(best_lane, best_ind_lane, 4);
+}
+
+__attribute__((target("avx2")))
+static uint32_t max_dot_avx2(const float *x, const float *y, const float *z,
+                             const uint32_t cnt, const T3DVec3 *dir)
+{
+        __m256 dx, dy, dz, best;
+        __m256i ind, best_ind, step;
+        float best_lane[8];
+        int32_t best_ind_lane[8];
+
+        dx = _mm256_set1_ps(dir->v[0]);
+        dy = _mm256_set1_ps(dir->v[1]);
+        dz = _mm256_set1_ps(dir->v[2]);
+        best = _mm256_set1_ps(-INFINITY);
+        best_ind = _mm256_setzero_si256();
+        ind = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        step = _mm256_set1_epi32(8);
+        for (uint32_t i = 0; i < cnt; i += 8) {
+                __m256 d, gt;
+
+                d = _mm256_add_ps(
+                        _mm256_add_ps(
+                                _mm256_mul_ps(_mm256_loadu_ps(x + i), dx),
+                                _mm256_mul_ps(_mm256_loadu_ps(y + i), dy)),
+                        _mm256_mul_ps(_mm256_loadu_ps(z + i), dz));
+                gt = _mm256_cmp_ps(d, best, _CMP_GT_OQ);
+                best = _mm256_blendv_ps(best, d, gt);
+                best_ind = _mm256_castps_si256(
+                        _mm256_blendv_ps(_mm256_castsi256_ps(best_ind),
+                                         _mm256_castsi256_ps(ind), gt));
+                ind = _mm256_add_epi32(ind, step);
+        }
+
+        _mm256_storeu_ps(best_lane, best);
+        _mm256_storeu_si256((__m256i *)best_ind_lane, best_ind);
+
+        return max_dot_reduce(best_lane, best_ind_lane, 8);
+}
+#endif
+
+/* Widest kernel this CPU runs, picked once. */
+enum max_dot_impl max_dot_get_impl(void)
+{
+#ifdef MAX_DOT_SIMD
+        static enum max_dot_impl impl = MAX_DOT_IMPL_COUNT;
+
+        if (impl == MAX_DOT_IMPL_COUNT) {
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx2"))
+                        impl = MAX_DOT_IMPL_AVX2;
+                else if (__builtin_cpu_supports("sse4.1"))
+                        impl = MAX_DOT_IMPL_SSE41;
+                else
+                        impl = MAX_DOT_IMPL_SCALAR;
+        }
+
+        return impl;
+#else
+        return MAX_DOT_IMPL_SCALAR;
+#endif
+}
+
+/* Unsupported kernels fall back to scalar. */
+uint32_t max_dot_with(const float *x, const float *y, const float *z,
+                      const uint32_t cnt, const T3DVec3 *dir,
+                      const enum max_dot_impl impl)
+{
+#ifdef MAX_DOT_SIMD
+        if (impl > max_dot_get_impl())
+                return max_dot_scalar(x, y, z, cnt, dir);
+
+        switch (impl) {
+                case MAX_DOT_IMPL_AVX2:
+                        return max_dot_avx2(x, y, z, cnt, dir);
+
+                case MAX_DOT_IMPL_SSE41:
+                        return max_dot_sse41(x, y, z, cnt, dir);
+
+                default:
+                        break;
+        }
+#else
+        (void)impl;
+#endif
+
+        return max_dot_scalar(x, y, z, cnt, dir);
+}
+
+uint32_t max_dot(const float *x, const float *y, const float *z,
+                 const uint32_t cnt, const T3DVec3 *dir)
+{
+#ifdef MAX_DOT_SIMD
+        if (cnt >= MAX_DOT_SIMD_MIN)
+                return max_dot_with(x, y, z, cnt, dir, max_dot_get_impl());
+#endif
+
+        return max_dot_scalar(x, y, z, cnt, dir);
+}
+
+const char *max_dot_impl_to_string(const enum max_dot_impl impl)
+{
+        static const char *strs[MAX_DOT_IMPL_COUNT] = {
+                "scalar", "sse4.1", "avx2"
+        };
+
+        return (impl < MAX_DOT_IMPL_COUNT) ? strs[impl] : "unknown";
+}
@@ -0,0 +1,29 @@
+#ifndef MAX_DOT_H
+#define MAX_DOT_H
+
+#include <t3d/t3dmath.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MAX_DOT_SIMD
+#endif
+
+#define MAX_DOT_SIMD_MIN 32 /* Below this the reduction costs more */
+
+enum max_dot_impl {
+        MAX_DOT_IMPL_SCALAR,
+        MAX_DOT_IMPL_SSE41,
+        MAX_DOT_IMPL_AVX2,
+        MAX_DOT_IMPL_COUNT
+};
+
+uint32_t max_dot_scalar(const float *x, const float *y, const float *z,
+                        const uint32_t cnt, const T3DVec3 *dir);
+uint32_t max_dot(const float *x, const float *y, const float *z,
+                 const uint32_t cnt, const T3DVec3 *dir);
+uint32_t max_dot_with(const float *x, const float *y, const float *z,
+                      const uint32_t cnt, const T3DVec3 *dir,
+                      const enum max_dot_impl impl);
+enum max_dot_impl max_dot_get_impl(void);
+const char *max_dot_impl_to_string(const enum max_dot_impl impl);
+
+#endif /* MAX_DOT_H */
@@ -0,0 +1,191 @@
+#include <libdragon.h>
+
+#include "epa.h"
+#include "mpr.h"
+
+static void mpr_centre(struct gjk_vertex *out, const struct shape *a,
+                       const struct shape *b)
+{
+        shape_get_centre(&out->a, a);
+        shape_get_centre(&out->b, b);
+        t3d_vec3_diff(&out->w, &out->a, &out->b);
+
+        /* Centres coincide, any nudge gives the origin ray a direction. */
+        if (!t3d_vec3_len2(&out->w))
+                out->w.v[0] = MPR_EPS;
+}
+
+static void mpr_triangle_normal(T3DVec3 *n, const T3DVec3 *a,
+                                const T3DVec3 *b, const T3DVec3 *c)
+{
+        T3DVec3 ab, ac;
+
+        t3d_vec3_diff(&ab, b, a);
+        t3d_vec3_diff(&ac, c, a);
+        t3d_vec3_cross(n, &ab, &ac);
+}
+
+/*
+ * Phase 1: find a portal (v1, v2, v3) which the ray from the interior point
+ * v0 towards the origin passes through. Returns -1 if the shapes are
+ * separated, 0 if a portal was found, 1 if the origin sits on the v0 -> v1
+ * segment (so they're touching or overlapping along it).
+ */
+static int mpr_discover_portal(struct gjk_vertex *v, const struct shape *a,
+                               const struct shape *b)
+{
+        T3DVec3 n, tmp;
+
+        mpr_centre(v + 0, a, b);
+        t3d_vec3_scale(&n, &v[0].w, -1.f);
+        gjk_support(v + 1, a, b, &n);
+        if (t3d_vec3_dot(&v[1].w, &n) <= 0.f)
+                return -1;
+
+        t3d_vec3_cross(&n, &v[1].w, &v[0].w);
+        if (t3d_vec3_len2(&n) <= MPR_EPS * MPR_EPS)
+                return 1;
+
+        gjk_support(v + 2, a, b, &n);
+        if (t3d_vec3_dot(&v[2].w, &n) <= 0.f)
+                return -1;
+
+        mpr_triangle_normal(&n, &v[0].w, &v[1].w, &v[2].w);
+        if (t3d_vec3_dot(&n, &v[0].w) > 0.f) {
+                struct gjk_vertex swap;
+
+                swap = v[1];
+                v[1] = v[2];
+                v[2] = swap;
+                t3d_vec3_scale(&n, &n, -1.f);
+        }
+
+        for (int iter = 0; iter < MPR_ITER_MAX; ++iter) {
+                gjk_support(v + 3, a, b, &n);
+                if (t3d_vec3_dot(&v[3].w, &n) <= 0.f)
+                        return -1;
+
+                t3d_vec3_cross(&tmp, &v[1].w, &v[3].w);
+                if (t3d_vec3_dot(&tmp, &v[0].w) < 0.f) {
+                        v[2] = v[3];
+                        mpr_triangle_normal(&n, &v[0].w, &v[1].w, &v[3].w);
+                        continue;
+                }
+
+                t3d_vec3_cross(&tmp, &v[3].w, &v[2].w);
+                if (t3d_vec3_dot(&tmp, &v[0].w) < 0.f) {
+                        v[1] = v[3];
+                        mpr_triangle_normal(&n, &v[0].w, &v[3].w, &v[2].w);
+                        continue;
+                }
+
+                return 0;
+        }
+
+        return 0;
+}
+
+/* Phase 2: swap portal vertices for new support points until it's tight. */
+static bool mpr_refine_portal(struct contact *c, struct gjk_vertex *v,
+                              const struct shape *a, const struct shape *b,
+                              const bool boolean_only)
+{
+        bool hit;
+
+        hit = false;
+        for (int iter = 0; iter < MPR_ITER_MAX; ++iter) {
+                struct gjk_vertex v4;
+                T3DVec3 n, t, step;
+                float n_len, portal_dist;
+
+                mpr_triangle_normal(&n, &v[1].w, &v[2].w, &v[3].w);
+                n_len = t3d_vec3_len(&n);
+                if (n_len <= MPR_EPS * MPR_EPS)
+                        break;
+
+                t3d_vec3_scale(&n, &n, 1.f / n_len);
+                portal_dist = t3d_vec3_dot(&n, &v[1].w);
+                if (portal_dist >= 0.f) {
+                        hit = true;
+                        if (boolean_only)
+                                return true;
+                }
+
+                gjk_support(&v4, a, b, &n);
+                if (!hit && t3d_vec3_dot(&v4.w, &n) <= 0.f)
+                        return false;
+
+                t3d_vec3_diff(&step, &v4.w, &v[3].w);
+                if (t3d_vec3_dot(&step, &n) <= MPR_EPS) {
+                        if (hit)
+                                epa_contact_from_triangle(c, v + 1, v + 2,
+                                                          v + 3, &n,
+                                                          portal_dist);
+                        return hit;
+                }
+
+                /* Keep whichever sub-portal the origin ray passes through. */
+                t3d_vec3_cross(&t, &v4.w, &v[0].w);
+                if (t3d_vec3_dot(&v[1].w, &t) > 0.f) {
+                        if (t3d_vec3_dot(&v[2].w, &t) > 0.f)
+                                v[1] = v4;
+                        else
+                                v[3] = v4;
+                } else {
+                        if (t3d_vec3_dot(&v[3].w, &t) > 0.f)
+                                v[2] = v4;
+                        else
+                                v[1] = v4;
+                }
+        }
+
+        if (hit) {
+                T3DVec3 n;
+
+                mpr_triangle_normal(&n, &v[1].w, &v[2].w, &v[3].w);
+                t3d_vec3_norm(&n);
+                epa_contact_from_triangle(c, v + 1, v + 2, v + 3, &n,
+                                          t3d_vec3_dot(&n, &v[1].w));
+        }
+
+        return hit;
+}
+
+static bool mpr_run(struct contact *c, const struct shape *a,
+                    const struct shape *b, const bool boolean_only)
+{
+        struct gjk_vertex v[4];
+
+        switch (mpr_discover_portal(v, a, b)) {
+                case -1:
+                        return false;
+
+                case 1:
+                        if (boolean_only)
+                                return true;
+
+                        /* Origin lies on the v0 -> v1 segment. */
+                        t3d_vec3_diff(&c->normal, &v[1].w, &v[0].w);
+                        c->depth = t3d_vec3_len(&v[1].w);
+                        t3d_vec3_norm(&c->normal);
+                        c->point_a = v[1].a;
+                        c->point_b = v[1].b;
+                        return true;
+
+                default:
+                        return mpr_refine_portal(c, v, a, b, boolean_only);
+        }
+}
+
+/* Minkowski Portal Refinement (Snethen, XenoCollide), overlap only. */
+bool mpr_intersect(const struct shape *a, const struct shape *b)
+{
+        return mpr_run(NULL, a, b, true);
+}
+
+/* As above, with an approximate normal and depth from the final portal. */
+bool mpr_collide(struct contact *c, const struct shape *a,
+                 const struct shape *b)
+{
+        return mpr_run(c, a, b, false);
+}
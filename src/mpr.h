@@ -0,0 +1,14 @@
+#ifndef MPR_H
+#define MPR_H
+
+#include "contact.h"
+#include "shape.h"
+
+#define MPR_ITER_MAX 32
+#define MPR_EPS 1e-4f
+
+bool mpr_intersect(const struct shape *a, const struct shape *b);
+bool mpr_collide(struct contact *c, const struct shape *a,
+                 const struct shape *b);
+
+#endif /* MPR_H */
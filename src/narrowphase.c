@@ -0,0 +1,366 @@
+#include <libdragon.h>
+
+#include "epa.h"
+#include "mpr.h"
+#include "narrowphase.h"
+
+#define NARROWPHASE_EPS 1e-8f
+
+typedef bool (*narrowphase_func)(struct contact *c, const struct shape *a,
+                                 const struct shape *b);
+
+struct narrowphase_entry {
+        narrowphase_func func;
+        bool swap; /* Written for (B, A), so flip the result */
+};
+
+static float narrowphase_clampf(const float x, const float lo, const float hi)
+{
+        return (x < lo) ? lo : ((x > hi) ? hi : x);
+}
+
+static void narrowphase_get_segment(T3DVec3 *p0, T3DVec3 *p1,
+                                    const struct shape *s)
+{
+        T3DVec3 axis;
+
+        axis = (s->axes) ? s->axes[2] : (T3DVec3){{0.f, 0.f, 1.f}};
+        t3d_vec3_scale(&axis, &axis, s->capsule.half_height);
+        t3d_vec3_diff(p0, &s->pos, &axis);
+        t3d_vec3_add(p1, &s->pos, &axis);
+}
+
+static void narrowphase_closest_on_segment(T3DVec3 *out, const T3DVec3 *p,
+                                           const T3DVec3 *s0,
+                                           const T3DVec3 *s1)
+{
+        T3DVec3 d, sp;
+        float len2, t;
+
+        t3d_vec3_diff(&d, s1, s0);
+        t3d_vec3_diff(&sp, p, s0);
+        len2 = t3d_vec3_len2(&d);
+        t = (len2 > NARROWPHASE_EPS) ? t3d_vec3_dot(&sp, &d) / len2 : 0.f;
+        t = narrowphase_clampf(t, 0.f, 1.f);
+        t3d_vec3_scale(out, &d, t);
+        t3d_vec3_add(out, out, s0);
+}
+
+/* Closest points between segments `p1q1` and `p2q2` (Ericson, RTCD 5.1.9). */
+static void narrowphase_closest_segments(T3DVec3 *c1, T3DVec3 *c2,
+                                         const T3DVec3 *p1, const T3DVec3 *q1,
+                                         const T3DVec3 *p2, const T3DVec3 *q2)
+{
+        T3DVec3 d1, d2, r;
+        float a, e, f, s, t;
+
+        t3d_vec3_diff(&d1, q1, p1);
+        t3d_vec3_diff(&d2, q2, p2);
+        t3d_vec3_diff(&r, p1, p2);
+        a = t3d_vec3_len2(&d1);
+        e = t3d_vec3_len2(&d2);
+        f = t3d_vec3_dot(&d2, &r);
+
+        if (a <= NARROWPHASE_EPS && e <= NARROWPHASE_EPS) {
+                s = 0.f;
+                t = 0.f;
+        } else if (a <= NARROWPHASE_EPS) {
+                s = 0.f;
+                t = narrowphase_clampf(f / e, 0.f, 1.f);
+        } else {
+                float c;
+
+                c = t3d_vec3_dot(&d1, &r);
+                if (e <= NARROWPHASE_EPS) {
+                        t = 0.f;
+                        s = narrowphase_clampf(-c / a, 0.f, 1.f);
+                } else {
+                        float b, denom;
+
+                        b = t3d_vec3_dot(&d1, &d2);
+                        denom = a * e - b * b;
+                        s = (denom) ? narrowphase_clampf((b * f - c * e) /
+                                                         denom, 0.f, 1.f) :
+                            0.f;
+                        t = (b * s + f) / e;
+                        if (t < 0.f) {
+                                t = 0.f;
+                                s = narrowphase_clampf(-c / a, 0.f, 1.f);
+                        } else if (t > 1.f) {
+                                t = 1.f;
+                                s = narrowphase_clampf((b - c) / a, 0.f, 1.f);
+                        }
+                }
+        }
+
+        t3d_vec3_scale(c1, &d1, s);
+        t3d_vec3_add(c1, c1, p1);
+        t3d_vec3_scale(c2, &d2, t);
+        t3d_vec3_add(c2, c2, p2);
+}
+
+static bool narrowphase_spheres(struct contact *c,
+                                const T3DVec3 *ca, const float ra,
+                                const T3DVec3 *cb, const float rb)
+{
+        T3DVec3 d;
+        float dist2, dist, r;
+
+        t3d_vec3_diff(&d, cb, ca);
+        dist2 = t3d_vec3_len2(&d);
+        r = ra + rb;
+        if (dist2 > r * r)
+                return false;
+
+        dist = sqrtf(dist2);
+        if (dist > NARROWPHASE_EPS)
+                t3d_vec3_scale(&c->normal, &d, 1.f / dist);
+        else
+                c->normal = (T3DVec3){{0.f, 0.f, 1.f}};
+
+        t3d_vec3_scale(&c->point_a, &c->normal, ra);
+        t3d_vec3_add(&c->point_a, &c->point_a, ca);
+        t3d_vec3_scale(&c->point_b, &c->normal, -rb);
+        t3d_vec3_add(&c->point_b, &c->point_b, cb);
+        c->depth = r - dist;
+
+        return true;
+}
+
+static bool narrowphase_sphere_sphere(struct contact *c, const struct shape *a,
+                                      const struct shape *b)
+{
+        return narrowphase_spheres(c, &a->pos, a->sphere.radius + a->margin,
+                                   &b->pos, b->sphere.radius + b->margin);
+}
+
+static bool narrowphase_sphere_capsule(struct contact *c,
+                                       const struct shape *a,
+                                       const struct shape *b)
+{
+        T3DVec3 p0, p1, q;
+
+        narrowphase_get_segment(&p0, &p1, b);
+        narrowphase_closest_on_segment(&q, &a->pos, &p0, &p1);
+
+        return narrowphase_spheres(c, &a->pos, a->sphere.radius + a->margin,
+                                   &q, b->capsule.radius + b->margin);
+}
+
+static bool narrowphase_capsule_capsule(struct contact *c,
+                                        const struct shape *a,
+                                        const struct shape *b)
+{
+        T3DVec3 pa0, pa1, pb0, pb1, qa, qb;
+
+        narrowphase_get_segment(&pa0, &pa1, a);
+        narrowphase_get_segment(&pb0, &pb1, b);
+        narrowphase_closest_segments(&qa, &qb, &pa0, &pa1, &pb0, &pb1);
+
+        return narrowphase_spheres(c, &qa, a->capsule.radius + a->margin,
+                                   &qb, b->capsule.radius + b->margin);
+}
+
+static void narrowphase_box_to_world(T3DVec3 *out, const struct shape *box,
+                                     const T3DVec3 *local, const bool is_point)
+{
+        if (box->axes) {
+                T3DVec3 axis;
+
+                t3d_vec3_scale(out, box->axes + 0, local->v[0]);
+                t3d_vec3_scale(&axis, box->axes + 1, local->v[1]);
+                t3d_vec3_add(out, out, &axis);
+                t3d_vec3_scale(&axis, box->axes + 2, local->v[2]);
+                t3d_vec3_add(out, out, &axis);
+        } else {
+                *out = *local;
+        }
+
+        if (is_point)
+                t3d_vec3_add(out, out, &box->pos);
+}
+
+static bool narrowphase_sphere_box(struct contact *c, const struct shape *a,
+                                   const struct shape *b)
+{
+        const T3DVec3 *half;
+        T3DVec3 d, local, q, n_local;
+        float r;
+        bool inside;
+
+        /* Rounded boxes don't have a closed form worth the trouble. */
+        if (b->margin)
+                return narrowphase_collide_generic(c, a, b);
+
+        half = &b->box.half_extents;
+        r = a->sphere.radius + a->margin;
+        t3d_vec3_diff(&d, &a->pos, &b->pos);
+        for (int i = 0; i < 3; ++i)
+                local.v[i] = (b->axes) ? t3d_vec3_dot(&d, b->axes + i) :
+                             d.v[i];
+
+        inside = true;
+        for (int i = 0; i < 3; ++i) {
+                q.v[i] = narrowphase_clampf(local.v[i], -half->v[i],
+                                            half->v[i]);
+                inside &= (q.v[i] == local.v[i]);
+        }
+
+        if (!inside) {
+                T3DVec3 to_box;
+                float dist2, dist;
+
+                t3d_vec3_diff(&to_box, &q, &local);
+                dist2 = t3d_vec3_len2(&to_box);
+                if (dist2 > r * r)
+                        return false;
+
+                dist = sqrtf(dist2);
+                t3d_vec3_scale(&n_local, &to_box, 1.f / dist);
+                c->depth = r - dist;
+        } else {
+                float face_dist;
+                int axis;
+
+                /* Centre is inside, push out through the nearest face. */
+                axis = 0;
+                face_dist = half->v[0] - fabsf(local.v[0]);
+                for (int i = 1; i < 3; ++i) {
+                        float fd;
+
+                        fd = half->v[i] - fabsf(local.v[i]);
+                        if (fd < face_dist) {
+                                face_dist = fd;
+                                axis = i;
+                        }
+                }
+
+                n_local = (T3DVec3){{0.f, 0.f, 0.f}};
+                n_local.v[axis] = (local.v[axis] >= 0.f) ? -1.f : 1.f;
+                q.v[axis] = -n_local.v[axis] * half->v[axis];
+                c->depth = r + face_dist;
+        }
+
+        narrowphase_box_to_world(&c->normal, b, &n_local, false);
+        narrowphase_box_to_world(&c->point_b, b, &q, true);
+        t3d_vec3_scale(&c->point_a, &c->normal, r);
+        t3d_vec3_add(&c->point_a, &c->point_a, &a->pos);
+
+        return true;
+}
+
+/* Pairs without an entry fall back on GJK + EPA or MPR. */
+static const struct narrowphase_entry
+narrowphase_table[SHAPE_TYPE_COUNT][SHAPE_TYPE_COUNT] = {
+        [SHAPE_SPHERE][SHAPE_SPHERE] = {narrowphase_sphere_sphere, false},
+        [SHAPE_SPHERE][SHAPE_CAPSULE] = {narrowphase_sphere_capsule, false},
+        [SHAPE_CAPSULE][SHAPE_SPHERE] = {narrowphase_sphere_capsule, true},
+        [SHAPE_CAPSULE][SHAPE_CAPSULE] = {narrowphase_capsule_capsule, false},
+        [SHAPE_SPHERE][SHAPE_BOX] = {narrowphase_sphere_box, false},
+        [SHAPE_BOX][SHAPE_SPHERE] = {narrowphase_sphere_box, true},
+};
+
+static enum narrowphase_algo
+narrowphase_algos[SHAPE_TYPE_COUNT][SHAPE_TYPE_COUNT] = {
+        [0 ... SHAPE_TYPE_COUNT - 1] = {
+                [0 ... SHAPE_TYPE_COUNT - 1] = NARROWPHASE_ALGO_DEFAULT
+        }
+};
+
+void narrowphase_set_algo(const enum shape_type a, const enum shape_type b,
+                          const enum narrowphase_algo algo)
+{
+        narrowphase_algos[a][b] = algo;
+        narrowphase_algos[b][a] = algo;
+}
+
+enum narrowphase_algo narrowphase_get_algo(const enum shape_type a,
+                                           const enum shape_type b)
+{
+        return narrowphase_algos[a][b];
+}
+
+const char *narrowphase_algo_to_string(const enum narrowphase_algo algo)
+{
+        switch (algo) {
+                case NARROWPHASE_ALGO_GJK_EPA:
+                        return "GJK+EPA";
+
+                case NARROWPHASE_ALGO_MPR:
+                        return "MPR";
+
+                default:
+                        return NULL;
+        }
+}
+
+static bool narrowphase_collide_algo(struct contact *c, const struct shape *a,
+                                     const struct shape *b,
+                                     const enum narrowphase_algo algo,
+                                     struct gjk_cache *cache)
+{
+        struct gjk_simplex s;
+        struct gjk_result res;
+
+#ifdef COLLISION_FIXED_POINT
+        if (!gjk_fixed_may_touch(a, b))
+                return false;
+#endif
+
+        if (algo == NARROWPHASE_ALGO_MPR)
+                return mpr_collide(c, a, b);
+
+        if (!gjk_distance_cached(&res, &s, a, b, cache))
+                return false;
+
+        epa_penetration(c, &s, a, b);
+
+        return true;
+}
+
+bool narrowphase_collide_with(struct contact *c, const struct shape *a,
+                              const struct shape *b,
+                              const enum narrowphase_algo algo)
+{
+        return narrowphase_collide_algo(c, a, b, algo, NULL);
+}
+
+bool narrowphase_collide_generic(struct contact *c, const struct shape *a,
+                                 const struct shape *b)
+{
+        return narrowphase_collide_with(c, a, b,
+                                        narrowphase_algos[a->type][b->type]);
+}
+
+bool narrowphase_collide(struct contact *c, const struct shape *a,
+                         const struct shape *b)
+{
+        return narrowphase_collide_cached(c, a, b, NULL);
+}
+
+/* `cache` is only used by the GJK path, closed forms don't need one. */
+bool narrowphase_collide_cached(struct contact *c, const struct shape *a,
+                                const struct shape *b,
+                                struct gjk_cache *cache)
+{
+        const struct narrowphase_entry *e;
+        T3DVec3 tmp;
+
+        e = &narrowphase_table[a->type][b->type];
+        if (!e->func)
+                return narrowphase_collide_algo(
+                        c, a, b, narrowphase_algos[a->type][b->type], cache);
+
+        if (!e->swap)
+                return e->func(c, a, b);
+
+        if (!e->func(c, b, a))
+                return false;
+
+        t3d_vec3_scale(&c->normal, &c->normal, -1.f);
+        tmp = c->point_a;
+        c->point_a = c->point_b;
+        c->point_b = tmp;
+
+        return true;
+}
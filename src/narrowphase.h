@@ -0,0 +1,35 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include "contact.h"
+#include "gjk.h"
+#include "shape.h"
+
+enum narrowphase_algo {
+        NARROWPHASE_ALGO_GJK_EPA,
+        NARROWPHASE_ALGO_MPR,
+        NARROWPHASE_ALGO_COUNT
+};
+
+/* Used for every pair type without a closed-form test until overridden. */
+#ifndef NARROWPHASE_ALGO_DEFAULT
+#define NARROWPHASE_ALGO_DEFAULT NARROWPHASE_ALGO_GJK_EPA
+#endif
+
+bool narrowphase_collide(struct contact *c, const struct shape *a,
+                         const struct shape *b);
+bool narrowphase_collide_cached(struct contact *c, const struct shape *a,
+                                const struct shape *b,
+                                struct gjk_cache *cache);
+bool narrowphase_collide_generic(struct contact *c, const struct shape *a,
+                                 const struct shape *b);
+bool narrowphase_collide_with(struct contact *c, const struct shape *a,
+                              const struct shape *b,
+                              const enum narrowphase_algo algo);
+void narrowphase_set_algo(const enum shape_type a, const enum shape_type b,
+                          const enum narrowphase_algo algo);
+enum narrowphase_algo narrowphase_get_algo(const enum shape_type a,
+                                           const enum shape_type b);
+const char *narrowphase_algo_to_string(const enum narrowphase_algo algo);
+
+#endif /* NARROWPHASE_H */
@@ -0,0 +1,45 @@
+#include <libdragon.h>
+
+#include "pool.h"
+
+struct pool pool_create(const uint32_t item_size, const uint32_t cap,
+                        struct arena *ar)
+{
+        struct pool p;
+
+        p.items = arena_alloc(ar, (size_t)item_size * cap);
+        p.item_size = item_size;
+        p.cap = cap;
+        p.cnt = 0;
+        p.high_water = 0;
+        p.dropped = 0;
+
+        return p;
+}
+
+void pool_clear(struct pool *p)
+{
+        p->cnt = 0;
+        p->dropped = 0;
+}
+
+void *pool_push(struct pool *p)
+{
+        void *item;
+
+        if (p->cnt >= p->cap) {
+                ++p->dropped;
+                return NULL;
+        }
+
+        item = p->items + (size_t)p->item_size * p->cnt++;
+        if (p->cnt > p->high_water)
+                p->high_water = p->cnt;
+
+        return item;
+}
+
+void *pool_get(const struct pool *p, const uint32_t i)
+{
+        return p->items + (size_t)p->item_size * i;
+}
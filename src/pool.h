@@ -0,0 +1,26 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "arena.h"
+
+/*
+ * Fixed-capacity item list carved out of an arena once, so filling it in
+ * the tick loop never touches the heap. Pushing past `cap` is refused and
+ * counted rather than grown.
+ */
+struct pool {
+        uint8_t *items;
+        uint32_t item_size;
+        uint32_t cap;
+        uint32_t cnt;
+        uint32_t high_water;
+        uint32_t dropped; /* Refused pushes since the last clear */
+};
+
+struct pool pool_create(const uint32_t item_size, const uint32_t cap,
+                        struct arena *ar);
+void pool_clear(struct pool *p);
+void *pool_push(struct pool *p);
+void *pool_get(const struct pool *p, const uint32_t i);
+
+#endif /* POOL_H */
@@ -0,0 +1,474 @@
+#include <libdragon.h>
+
+#include "shape.h"
+
+static struct shape shape_make(const enum shape_type type, const T3DVec3 *pos)
+{
+        struct shape s;
+
+        s.type = type;
+        s.margin = 0.f;
+        s.pos = *pos;
+        s.axes = NULL;
+
+        return s;
+}
+
+struct shape shape_make_hull(const struct collision_hull *h,
+                             const T3DVec3 *pos)
+{
+        struct shape s;
+
+        s = shape_make(SHAPE_HULL, pos);
+        s.hull = h;
+
+        return s;
+}
+
+struct shape shape_make_triangle(const struct collision_triangle *tri,
+                                 const T3DVec3 *pos)
+{
+        struct shape s;
+
+        s = shape_make(SHAPE_TRIANGLE, pos);
+        s.tri = tri;
+
+        return s;
+}
+
+struct shape shape_make_sphere(const float radius, const T3DVec3 *pos)
+{
+        struct shape s;
+
+        s = shape_make(SHAPE_SPHERE, pos);
+        s.sphere.radius = radius;
+
+        return s;
+}
+
+struct shape shape_make_capsule(const float radius, const float half_height,
+                                const T3DVec3 *pos)
+{
+        struct shape s;
+
+        s = shape_make(SHAPE_CAPSULE, pos);
+        s.capsule.radius = radius;
+        s.capsule.half_height = half_height;
+
+        return s;
+}
+
+struct shape shape_make_box(const T3DVec3 *half_extents, const T3DVec3 *pos,
+                            const T3DVec3 *axes)
+{
+        struct shape s;
+
+        s = shape_make(SHAPE_BOX, pos);
+        s.axes = axes;
+        s.box.half_extents = *half_extents;
+
+        return s;
+}
+
+struct shape shape_make_cylinder(const float radius, const float half_height,
+                                 const T3DVec3 *pos)
+{
+        struct shape s;
+
+        s = shape_make(SHAPE_CYLINDER, pos);
+        s.cylinder.radius = radius;
+        s.cylinder.half_height = half_height;
+
+        return s;
+}
+
+struct shape shape_make_cone(const float radius, const float half_height,
+                             const T3DVec3 *pos)
+{
+        struct shape s;
+
+        s = shape_make(SHAPE_CONE, pos);
+        s.cone.radius = radius;
+        s.cone.half_height = half_height;
+
+        return s;
+}
+
+/* Rounds off any shape, e.g. a sphere-swept hull. */
+void shape_set_margin(struct shape *s, const float margin)
+{
+        s->margin = margin;
+}
+
+static void shape_support_triangle(T3DVec3 *out,
+                                   const struct collision_triangle *tri,
+                                   const T3DVec3 *dir)
+{
+        float d[3];
+        int best;
+
+        for (int i = 0; i < 3; ++i)
+                d[i] = t3d_vec3_dot(tri->pos + i, dir);
+
+        best = (d[1] > d[0]) ? 1 : 0;
+        if (d[2] > d[best])
+                best = 2;
+
+        *out = tri->pos[best];
+}
+
+static void shape_support_sphere(T3DVec3 *out, const float radius,
+                                 const T3DVec3 *dir)
+{
+        float len;
+
+        len = t3d_vec3_len(dir);
+        if (!len) {
+                *out = (T3DVec3){{0.f, 0.f, 0.f}};
+                return;
+        }
+
+        t3d_vec3_scale(out, dir, radius / len);
+}
+
+static void shape_support_box(T3DVec3 *out, const T3DVec3 *half_extents,
+                              const T3DVec3 *dir)
+{
+        for (int i = 0; i < 3; ++i)
+                out->v[i] = (dir->v[i] >= 0.f) ? half_extents->v[i] :
+                            -half_extents->v[i];
+}
+
+static void shape_support_cylinder(T3DVec3 *out, const float radius,
+                                   const float half_height, const T3DVec3 *dir)
+{
+        float radial;
+
+        radial = sqrtf(dir->v[0] * dir->v[0] + dir->v[1] * dir->v[1]);
+        if (radial) {
+                out->v[0] = dir->v[0] * radius / radial;
+                out->v[1] = dir->v[1] * radius / radial;
+        } else {
+                out->v[0] = 0.f;
+                out->v[1] = 0.f;
+        }
+
+        out->v[2] = (dir->v[2] >= 0.f) ? half_height : -half_height;
+}
+
+static void shape_support_cone(T3DVec3 *out, const float radius,
+                               const float half_height, const T3DVec3 *dir)
+{
+        float radial, sin_half_angle;
+
+        /* Apex wins whenever `dir` is inside the cone's normal cone. */
+        sin_half_angle = radius / sqrtf(radius * radius +
+                                        4.f * half_height * half_height);
+        if (dir->v[2] > t3d_vec3_len(dir) * sin_half_angle) {
+                *out = (T3DVec3){{0.f, 0.f, half_height}};
+                return;
+        }
+
+        radial = sqrtf(dir->v[0] * dir->v[0] + dir->v[1] * dir->v[1]);
+        if (radial) {
+                out->v[0] = dir->v[0] * radius / radial;
+                out->v[1] = dir->v[1] * radius / radial;
+        } else {
+                out->v[0] = 0.f;
+                out->v[1] = 0.f;
+        }
+
+        out->v[2] = -half_height;
+}
+
+/* Furthest point along `dir`, in world space. */
+void shape_support(T3DVec3 *out, const struct shape *s, const T3DVec3 *dir)
+{
+        T3DVec3 dir_local;
+
+        dir_local = *dir;
+        if (s->axes)
+                for (int i = 0; i < 3; ++i)
+                        dir_local.v[i] = t3d_vec3_dot(dir, s->axes + i);
+
+        switch (s->type) {
+                case SHAPE_HULL:
+                        collision_hull_support(out, s->hull, &dir_local);
+                        break;
+
+                case SHAPE_TRIANGLE:
+                        shape_support_triangle(out, s->tri, &dir_local);
+                        break;
+
+                case SHAPE_SPHERE:
+                        shape_support_sphere(out, s->sphere.radius,
+                                             &dir_local);
+                        break;
+
+                case SHAPE_CAPSULE:
+                        shape_support_sphere(out, s->capsule.radius,
+                                             &dir_local);
+                        out->v[2] += (dir_local.v[2] >= 0.f) ?
+                                     s->capsule.half_height :
+                                     -s->capsule.half_height;
+                        break;
+
+                case SHAPE_BOX:
+                        shape_support_box(out, &s->box.half_extents,
+                                          &dir_local);
+                        break;
+
+                case SHAPE_CYLINDER:
+                        shape_support_cylinder(out, s->cylinder.radius,
+                                               s->cylinder.half_height,
+                                               &dir_local);
+                        break;
+
+                case SHAPE_CONE:
+                        shape_support_cone(out, s->cone.radius,
+                                           s->cone.half_height, &dir_local);
+                        break;
+
+                default:
+                        *out = (T3DVec3){{0.f, 0.f, 0.f}};
+                        break;
+        }
+
+        if (s->margin) {
+                T3DVec3 round;
+
+                shape_support_sphere(&round, s->margin, &dir_local);
+                t3d_vec3_add(out, out, &round);
+        }
+
+        if (s->axes) {
+                T3DVec3 local, axis;
+
+                local = *out;
+                t3d_vec3_scale(out, s->axes + 0, local.v[0]);
+                t3d_vec3_scale(&axis, s->axes + 1, local.v[1]);
+                t3d_vec3_add(out, out, &axis);
+                t3d_vec3_scale(&axis, s->axes + 2, local.v[2]);
+                t3d_vec3_add(out, out, &axis);
+        }
+
+        t3d_vec3_add(out, out, &s->pos);
+}
+
+/* Direction into the shape's local frame, no translation. */
+static void shape_dir_to_local(T3DVec3 *out, const struct shape *s,
+                               const T3DVec3 *dir)
+{
+        *out = *dir;
+        if (s->axes)
+                for (int i = 0; i < 3; ++i)
+                        out->v[i] = t3d_vec3_dot(dir, s->axes + i);
+}
+
+static void shape_dir_to_world(T3DVec3 *out, const struct shape *s,
+                               const T3DVec3 *dir)
+{
+        T3DVec3 local, axis;
+
+        local = *dir;
+        if (!s->axes) {
+                *out = local;
+                return;
+        }
+
+        t3d_vec3_scale(out, s->axes + 0, local.v[0]);
+        t3d_vec3_scale(&axis, s->axes + 1, local.v[1]);
+        t3d_vec3_add(out, out, &axis);
+        t3d_vec3_scale(&axis, s->axes + 2, local.v[2]);
+        t3d_vec3_add(out, out, &axis);
+}
+
+/* Inverse of shape_point_to_world(), for anchoring points to a shape. */
+void shape_point_to_local(T3DVec3 *out, const struct shape *s,
+                          const T3DVec3 *p)
+{
+        T3DVec3 d;
+
+        t3d_vec3_diff(&d, p, &s->pos);
+        if (!s->axes) {
+                *out = d;
+                return;
+        }
+
+        for (int i = 0; i < 3; ++i)
+                out->v[i] = t3d_vec3_dot(&d, s->axes + i);
+}
+
+void shape_point_to_world(T3DVec3 *out, const struct shape *s,
+                          const T3DVec3 *p)
+{
+        shape_dir_to_world(out, s, p);
+        t3d_vec3_add(out, out, &s->pos);
+}
+
+static int shape_get_face_box(T3DVec3 *verts, T3DVec3 *normal,
+                              const T3DVec3 *half, const T3DVec3 *dir)
+{
+        static const float corners[4][2] = {
+                {1.f, 1.f}, {-1.f, 1.f}, {-1.f, -1.f}, {1.f, -1.f}
+        };
+        float sign;
+        int k, u, v;
+
+        k = 0;
+        for (int i = 1; i < 3; ++i)
+                if (fabsf(dir->v[i]) > fabsf(dir->v[k]))
+                        k = i;
+
+        sign = (dir->v[k] >= 0.f) ? 1.f : -1.f;
+        u = (k + 1) % 3;
+        v = (k + 2) % 3;
+        *normal = (T3DVec3){{0.f, 0.f, 0.f}};
+        normal->v[k] = sign;
+        for (int i = 0; i < 4; ++i) {
+                int c;
+
+                /* Walk the other way round on the negative side. */
+                c = (sign > 0.f) ? i : 3 - i;
+                verts[i].v[k] = sign * half->v[k];
+                verts[i].v[u] = corners[c][0] * half->v[u];
+                verts[i].v[v] = corners[c][1] * half->v[v];
+        }
+
+        return 4;
+}
+
+/*
+ * Polygon of the face whose normal is closest to `dir`, wound CCW about
+ * `normal`, in world space. Returns its vertex count, which is 0 for
+ * curved shapes or when it doesn't fit in `vert_max`.
+ */
+int shape_get_face(T3DVec3 *verts, T3DVec3 *normal, const int vert_max,
+                   const struct shape *s, const T3DVec3 *dir)
+{
+        const struct collision_face *f;
+        T3DVec3 dir_local, n_local;
+        int cnt, ind;
+
+        shape_dir_to_local(&dir_local, s, dir);
+        switch (s->type) {
+                case SHAPE_HULL:
+                        ind = collision_hull_get_face(s->hull, &dir_local);
+                        if (ind < 0)
+                                return 0;
+
+                        f = s->hull->faces + ind;
+                        if (f->cnt > (uint32_t)vert_max)
+                                return 0;
+
+                        cnt = f->cnt;
+                        n_local = f->normal;
+                        for (int i = 0; i < cnt; ++i) {
+                                uint32_t v;
+
+                                v = s->hull->face_verts[f->first + i];
+                                verts[i] = (T3DVec3){{s->hull->vx[v],
+                                                      s->hull->vy[v],
+                                                      s->hull->vz[v]}};
+                        }
+
+                        break;
+
+                case SHAPE_BOX:
+                        if (vert_max < 4)
+                                return 0;
+
+                        cnt = shape_get_face_box(verts, &n_local,
+                                                 &s->box.half_extents,
+                                                 &dir_local);
+                        break;
+
+                default:
+                        return 0;
+        }
+
+        for (int i = 0; i < cnt; ++i)
+                shape_point_to_world(verts + i, s, verts + i);
+
+        shape_dir_to_world(normal, s, &n_local);
+
+        return cnt;
+}
+
+/* Some point strictly inside the shape, in world space. */
+void shape_get_centre(T3DVec3 *out, const struct shape *s)
+{
+        T3DVec3 local, axis;
+
+        switch (s->type) {
+                case SHAPE_HULL:
+                        local = s->hull->centre;
+                        break;
+
+                case SHAPE_TRIANGLE:
+                        t3d_vec3_add(&local, s->tri->pos + 0, s->tri->pos + 1);
+                        t3d_vec3_add(&local, &local, s->tri->pos + 2);
+                        t3d_vec3_scale(&local, &local, 1.f / 3.f);
+                        break;
+
+                default:
+                        *out = s->pos;
+                        return;
+        }
+
+        if (s->axes) {
+                t3d_vec3_scale(out, s->axes + 0, local.v[0]);
+                t3d_vec3_scale(&axis, s->axes + 1, local.v[1]);
+                t3d_vec3_add(out, out, &axis);
+                t3d_vec3_scale(&axis, s->axes + 2, local.v[2]);
+                t3d_vec3_add(out, out, &axis);
+        } else {
+                *out = local;
+        }
+
+        t3d_vec3_add(out, out, &s->pos);
+}
+
+void shape_get_bounds(T3DVec3 *min, T3DVec3 *max, const struct shape *s)
+{
+        for (int i = 0; i < 3; ++i) {
+                T3DVec3 dir, p;
+
+                dir = (T3DVec3){{0.f, 0.f, 0.f}};
+                dir.v[i] = 1.f;
+                shape_support(&p, s, &dir);
+                max->v[i] = p.v[i];
+                dir.v[i] = -1.f;
+                shape_support(&p, s, &dir);
+                min->v[i] = p.v[i];
+        }
+}
+
+const char *shape_type_to_string(const enum shape_type t)
+{
+        switch (t) {
+                case SHAPE_HULL:
+                        return "HULL";
+
+                case SHAPE_TRIANGLE:
+                        return "TRIANGLE";
+
+                case SHAPE_SPHERE:
+                        return "SPHERE";
+
+                case SHAPE_CAPSULE:
+                        return "CAPSULE";
+
+                case SHAPE_BOX:
+                        return "BOX";
+
+                case SHAPE_CYLINDER:
+                        return "CYLINDER";
+
+                case SHAPE_CONE:
+                        return "CONE";
+
+                default:
+                        return NULL;
+        }
+}
@@ -0,0 +1,75 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include "collision.h"
+
+enum shape_type {
+        SHAPE_HULL,
+        SHAPE_TRIANGLE,
+        SHAPE_SPHERE,
+        SHAPE_CAPSULE,
+        SHAPE_BOX,
+        SHAPE_CYLINDER,
+        SHAPE_CONE,
+        SHAPE_TYPE_COUNT
+};
+
+/*
+ * Capsules, cylinders and cones run along their local Z axis, and their
+ * `half_height` excludes any rounding. Cones have their apex at +Z.
+ */
+struct shape {
+        enum shape_type type;
+        float margin; /* Sphere-swept radius around the core shape */
+        T3DVec3 pos;
+        const T3DVec3 *axes; /* Local X/Y/Z in world space, NULL if none */
+        union {
+                const struct collision_hull *hull;
+                const struct collision_triangle *tri;
+                struct {
+                        float radius;
+                } sphere;
+                struct {
+                        float radius;
+                        float half_height;
+                } capsule;
+                struct {
+                        T3DVec3 half_extents;
+                } box;
+                struct {
+                        float radius;
+                        float half_height;
+                } cylinder;
+                struct {
+                        float radius;
+                        float half_height;
+                } cone;
+        };
+};
+
+struct shape shape_make_hull(const struct collision_hull *h,
+                             const T3DVec3 *pos);
+struct shape shape_make_triangle(const struct collision_triangle *tri,
+                                 const T3DVec3 *pos);
+struct shape shape_make_sphere(const float radius, const T3DVec3 *pos);
+struct shape shape_make_capsule(const float radius, const float half_height,
+                                const T3DVec3 *pos);
+struct shape shape_make_box(const T3DVec3 *half_extents, const T3DVec3 *pos,
+                            const T3DVec3 *axes);
+struct shape shape_make_cylinder(const float radius, const float half_height,
+                                 const T3DVec3 *pos);
+struct shape shape_make_cone(const float radius, const float half_height,
+                             const T3DVec3 *pos);
+void shape_set_margin(struct shape *s, const float margin);
+void shape_support(T3DVec3 *out, const struct shape *s, const T3DVec3 *dir);
+void shape_point_to_local(T3DVec3 *out, const struct shape *s,
+                          const T3DVec3 *p);
+void shape_point_to_world(T3DVec3 *out, const struct shape *s,
+                          const T3DVec3 *p);
+int shape_get_face(T3DVec3 *verts, T3DVec3 *normal, const int vert_max,
+                   const struct shape *s, const T3DVec3 *dir);
+void shape_get_centre(T3DVec3 *out, const struct shape *s);
+void shape_get_bounds(T3DVec3 *min, T3DVec3 *max, const struct shape *s);
+const char *shape_type_to_string(const enum shape_type t);
+
+#endif /* SHAPE_H */
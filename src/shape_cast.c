@@ -0,0 +1,120 @@
+#include <libdragon.h>
+
+#include "shape_cast.h"
+
+void shape_cast_init(struct shape_cast_hit *hit, const struct shape *caster,
+                     const T3DVec3 *move)
+{
+        hit->point = (T3DVec3){{0.f, 0.f, 0.f}};
+        hit->normal = (T3DVec3){{0.f, 0.f, 0.f}};
+        t3d_vec3_add(&hit->safe_pos, &caster->pos, move);
+        hit->fraction = 1.f;
+        hit->hit = false;
+}
+
+/*
+ * Only the part of the move before the current earliest hit is swept, so
+ * later targets get cheaper as the cast gets shorter.
+ */
+bool shape_cast_shape(struct shape_cast_hit *hit, const struct shape *caster,
+                      const T3DVec3 *move, const struct shape *target)
+{
+        static const T3DVec3 still = {{0.f, 0.f, 0.f}};
+        struct gjk_result res;
+        T3DVec3 move_left;
+        float toi;
+
+        t3d_vec3_scale(&move_left, move, hit->fraction);
+        if (!gjk_time_of_impact(&toi, &res, caster, &move_left,
+                                target, &still))
+                return false;
+
+        toi *= hit->fraction;
+        if (hit->hit && toi >= hit->fraction)
+                return false;
+
+        hit->point = res.point_b;
+        t3d_vec3_scale(&hit->normal, &res.normal, -1.f);
+        t3d_vec3_scale(&hit->safe_pos, move, toi);
+        t3d_vec3_add(&hit->safe_pos, &hit->safe_pos, &caster->pos);
+        hit->fraction = toi;
+        hit->hit = true;
+
+        return true;
+}
+
+static bool shape_cast_bounds_overlap(const T3DVec3 *min_a,
+                                      const T3DVec3 *max_a,
+                                      const T3DVec3 *min_b,
+                                      const T3DVec3 *max_b)
+{
+        for (int i = 0; i < 3; ++i)
+                if (min_a->v[i] > max_b->v[i] || max_a->v[i] < min_b->v[i])
+                        return false;
+
+        return true;
+}
+
+/*
+ * Sweeps against each triangle of the mesh's static, possibly concave
+ * pieces. Convex pieces are left to their hull shapes.
+ */
+bool shape_cast_mesh(struct shape_cast_hit *hit, const struct shape *caster,
+                     const T3DVec3 *move, const struct collision_data *mesh,
+                     const T3DVec3 *mesh_pos)
+{
+        T3DVec3 sweep_min, sweep_max;
+        bool found;
+
+        /* Swept bounds of the caster, relative to the mesh. */
+        shape_get_bounds(&sweep_min, &sweep_max, caster);
+        for (int i = 0; i < 3; ++i) {
+                float d;
+
+                d = move->v[i] * hit->fraction;
+                if (d < 0.f)
+                        sweep_min.v[i] += d;
+                else
+                        sweep_max.v[i] += d;
+
+                sweep_min.v[i] -= mesh_pos->v[i] + GJK_TOI_TOLERANCE;
+                sweep_max.v[i] += GJK_TOI_TOLERANCE - mesh_pos->v[i];
+        }
+
+        found = false;
+        for (uint32_t p = 0; p < mesh->piece_cnt; ++p) {
+                const struct collision_piece *piece;
+
+                piece = mesh->pieces + p;
+                if (piece->flags & COLLISION_PIECE_CONVEX)
+                        continue;
+
+                for (uint32_t i = piece->first;
+                     i < piece->first + piece->cnt; ++i) {
+                        const struct collision_triangle *tri;
+                        struct shape target;
+                        T3DVec3 tri_min, tri_max;
+
+                        tri = mesh->tris + i;
+                        tri_min = tri->pos[0];
+                        tri_max = tri->pos[0];
+                        for (int j = 1; j < 3; ++j) {
+                                for (int k = 0; k < 3; ++k) {
+                                        tri_min.v[k] = fminf(tri_min.v[k],
+                                                             tri->pos[j].v[k]);
+                                        tri_max.v[k] = fmaxf(tri_max.v[k],
+                                                             tri->pos[j].v[k]);
+                                }
+                        }
+
+                        if (!shape_cast_bounds_overlap(&sweep_min, &sweep_max,
+                                                       &tri_min, &tri_max))
+                                continue;
+
+                        target = shape_make_triangle(tri, mesh_pos);
+                        found |= shape_cast_shape(hit, caster, move, &target);
+                }
+        }
+
+        return found;
+}
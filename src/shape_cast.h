@@ -0,0 +1,22 @@
+#ifndef SHAPE_CAST_H
+#define SHAPE_CAST_H
+
+#include "gjk.h"
+
+struct shape_cast_hit {
+        T3DVec3 point; /* On the target */
+        T3DVec3 normal; /* Target's surface normal, facing the caster */
+        T3DVec3 safe_pos; /* Where the caster stops, just short of contact */
+        float fraction; /* Of the move travelled before the hit */
+        bool hit;
+};
+
+void shape_cast_init(struct shape_cast_hit *hit, const struct shape *caster,
+                     const T3DVec3 *move);
+bool shape_cast_shape(struct shape_cast_hit *hit, const struct shape *caster,
+                      const T3DVec3 *move, const struct shape *target);
+bool shape_cast_mesh(struct shape_cast_hit *hit, const struct shape *caster,
+                     const T3DVec3 *move, const struct collision_data *mesh,
+                     const T3DVec3 *mesh_pos);
+
+#endif /* SHAPE_CAST_H */
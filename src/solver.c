@@ -0,0 +1,165 @@
+#include <libdragon.h>
+
+#include "solver.h"
+
+/* Inverse effective mass of both bodies along `dir` at the contact. */
+static float solver_get_k(const struct body *ba, const struct body *bb,
+                          const T3DVec3 *ra, const T3DVec3 *rb,
+                          const T3DVec3 *dir)
+{
+        T3DVec3 rxd, tmp;
+        float k;
+
+        k = ba->inv_mass + bb->inv_mass;
+        t3d_vec3_cross(&rxd, ra, dir);
+        body_inv_inertia_mul(&tmp, ba, &rxd);
+        k += t3d_vec3_dot(&rxd, &tmp);
+        t3d_vec3_cross(&rxd, rb, dir);
+        body_inv_inertia_mul(&tmp, bb, &rxd);
+        k += t3d_vec3_dot(&rxd, &tmp);
+
+        return k;
+}
+
+static void solver_get_tangents(T3DVec3 *t, const T3DVec3 *n)
+{
+        if (fabsf(n->v[0]) >= .57735f)
+                t[0] = (T3DVec3){{n->v[1], -n->v[0], 0.f}};
+        else
+                t[0] = (T3DVec3){{0.f, n->v[2], -n->v[1]}};
+
+        t3d_vec3_norm(t + 0);
+        t3d_vec3_cross(t + 1, n, t + 0);
+}
+
+static void solver_get_rel_vel(T3DVec3 *out, const struct body *ba,
+                               const struct body *bb,
+                               const struct solver_row *r)
+{
+        T3DVec3 va, vb;
+
+        body_get_point_vel(&va, ba, &r->ra);
+        body_get_point_vel(&vb, bb, &r->rb);
+        t3d_vec3_diff(out, &vb, &va);
+}
+
+static void solver_apply(struct body *ba, struct body *bb,
+                         const struct solver_row *r, const T3DVec3 *dir,
+                         const float impulse)
+{
+        T3DVec3 p;
+
+        t3d_vec3_scale(&p, dir, impulse);
+        body_apply_impulse(bb, &p, &r->rb);
+        t3d_vec3_scale(&p, &p, -1.f);
+        body_apply_impulse(ba, &p, &r->ra);
+}
+
+/*
+ * Prepares a row for the contact and applies last tick's impulse straight
+ * away, so resting stacks start from a nearly solved state. Pairs where
+ * neither body can move are skipped.
+ */
+void solver_add(struct pool *rows, struct body *bodies, const uint16_t a,
+                const uint16_t b, const struct contact *c,
+                struct manifold_point *mp, const float dt)
+{
+        struct body *ba, *bb;
+        struct solver_row *r;
+        T3DVec3 vrel;
+        float k, vn;
+
+        ba = bodies + a;
+        bb = bodies + b;
+        if (!ba->inv_mass && !bb->inv_mass)
+                return;
+
+        r = pool_push(rows);
+        if (!r)
+                return;
+
+        r->a = a;
+        r->b = b;
+        body_get_centre(&r->ra, ba);
+        body_get_centre(&r->rb, bb);
+        t3d_vec3_diff(&r->ra, &c->point_a, &r->ra);
+        t3d_vec3_diff(&r->rb, &c->point_b, &r->rb);
+        r->n = c->normal;
+        solver_get_tangents(r->t, &r->n);
+
+        k = solver_get_k(ba, bb, &r->ra, &r->rb, &r->n);
+        r->mass_n = (k > 0.f) ? 1.f / k : 0.f;
+        for (int i = 0; i < 2; ++i) {
+                k = solver_get_k(ba, bb, &r->ra, &r->rb, r->t + i);
+                r->mass_t[i] = (k > 0.f) ? 1.f / k : 0.f;
+        }
+
+        /*
+         * Push out a share of the penetration, or bounce if closing fast.
+         * Separating speed along `n` is negative when they approach.
+         */
+        solver_get_rel_vel(&vrel, ba, bb, r);
+        vn = t3d_vec3_dot(&vrel, &r->n);
+        r->bias = SOLVER_BAUMGARTE / dt * fmaxf(c->depth - SOLVER_SLOP, 0.f);
+        if (vn < -SOLVER_BOUNCE_MIN)
+                r->bias = fmaxf(r->bias, -vn * fmaxf(ba->restitution,
+                                                     bb->restitution));
+
+        r->friction = sqrtf(ba->friction * bb->friction);
+        r->impulse_n = (mp) ? mp->impulse : 0.f;
+        r->impulse_t[0] = 0.f;
+        r->impulse_t[1] = 0.f;
+        r->mp = mp;
+        if (r->impulse_n)
+                solver_apply(ba, bb, r, &r->n, r->impulse_n);
+}
+
+/*
+ * Sequential impulses: each row in turn corrects its relative velocity,
+ * with the accumulated normal impulse clamped to push only, and friction
+ * clamped to the cone the normal impulse allows.
+ */
+void solver_solve(struct pool *rows, struct body *bodies,
+                  const int iter_cnt)
+{
+        for (int iter = 0; iter < iter_cnt; ++iter) {
+                for (uint32_t i = 0; i < rows->cnt; ++i) {
+                        struct solver_row *r;
+                        struct body *ba, *bb;
+                        T3DVec3 vrel;
+                        float lambda, acc, limit;
+
+                        r = pool_get(rows, i);
+                        ba = bodies + r->a;
+                        bb = bodies + r->b;
+
+                        solver_get_rel_vel(&vrel, ba, bb, r);
+                        limit = r->friction * r->impulse_n;
+                        for (int j = 0; j < 2; ++j) {
+                                lambda = -t3d_vec3_dot(&vrel, r->t + j) *
+                                         r->mass_t[j];
+                                acc = fminf(fmaxf(r->impulse_t[j] + lambda,
+                                                  -limit), limit);
+                                lambda = acc - r->impulse_t[j];
+                                r->impulse_t[j] = acc;
+                                solver_apply(ba, bb, r, r->t + j, lambda);
+                        }
+
+                        solver_get_rel_vel(&vrel, ba, bb, r);
+                        lambda = (r->bias - t3d_vec3_dot(&vrel, &r->n)) *
+                                 r->mass_n;
+                        acc = fmaxf(r->impulse_n + lambda, 0.f);
+                        lambda = acc - r->impulse_n;
+                        r->impulse_n = acc;
+                        solver_apply(ba, bb, r, &r->n, lambda);
+                }
+        }
+
+        for (uint32_t i = 0; i < rows->cnt; ++i) {
+                struct solver_row *r;
+
+                r = pool_get(rows, i);
+                if (r->mp)
+                        r->mp->impulse = r->impulse_n;
+        }
+}
@@ -0,0 +1,36 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "body.h"
+#include "manifold.h"
+#include "pool.h"
+
+#define SOLVER_ITER_CNT 8
+#define SOLVER_BAUMGARTE .2f /* Share of penetration fixed per tick */
+#define SOLVER_SLOP .005f /* Penetration left alone, keeps contacts alive */
+#define SOLVER_BOUNCE_MIN 1.f /* Closing speed below which nothing bounces */
+
+/* One contact point between two bodies, prepared for iteration. */
+struct solver_row {
+        uint16_t a;
+        uint16_t b;
+        T3DVec3 ra; /* From A's centre of mass to the contact */
+        T3DVec3 rb;
+        T3DVec3 n; /* From A towards B */
+        T3DVec3 t[2];
+        float mass_n;
+        float mass_t[2];
+        float bias; /* Target separating speed */
+        float friction;
+        float impulse_n;
+        float impulse_t[2];
+        struct manifold_point *mp; /* Warm start source and sink, or NULL */
+};
+
+void solver_add(struct pool *rows, struct body *bodies, const uint16_t a,
+                const uint16_t b, const struct contact *c,
+                struct manifold_point *mp, const float dt);
+void solver_solve(struct pool *rows, struct body *bodies,
+                  const int iter_cnt);
+
+#endif /* SOLVER_H */
@@ -0,0 +1,153 @@
+#ifdef COLLISION_THREADS
+
+#include <libdragon.h>
+
+#include "workers.h"
+
+/*
+ * Each thread starts on its own run of chunks, then steals from the
+ * others' queues in turn until everything is claimed. Claiming is one
+ * atomic add, so owner and thieves never lock, and a chunk is only ever
+ * handed out once.
+ */
+static void workers_drain(struct workers *wk, const int self)
+{
+        for (int k = 0; k < wk->cnt; ++k) {
+                struct workers_queue *q;
+
+                q = wk->queues + (self + k) % wk->cnt;
+                for (;;) {
+                        uint32_t chunk, first, cnt;
+
+                        chunk = __atomic_fetch_add(&q->head, 1,
+                                                   __ATOMIC_RELAXED);
+                        if (chunk >= q->end)
+                                break;
+
+                        first = chunk * wk->chunk_size;
+                        cnt = wk->item_cnt - first;
+                        if (cnt > wk->chunk_size)
+                                cnt = wk->chunk_size;
+
+                        wk->fn(wk->arg, first, cnt);
+                }
+        }
+}
+
+static void *workers_main(void *p)
+{
+        const struct workers_thread *t;
+        struct workers *wk;
+        uint32_t gen;
+
+        t = p;
+        wk = t->wk;
+        gen = 0;
+        pthread_mutex_lock(&wk->lock);
+        for (;;) {
+                while (wk->gen == gen && !wk->quit)
+                        pthread_cond_wait(&wk->wake, &wk->lock);
+
+                if (wk->quit)
+                        break;
+
+                gen = wk->gen;
+                pthread_mutex_unlock(&wk->lock);
+                workers_drain(wk, t->self);
+                pthread_mutex_lock(&wk->lock);
+                if (!--wk->busy)
+                        pthread_cond_signal(&wk->done);
+        }
+
+        pthread_mutex_unlock(&wk->lock);
+
+        return NULL;
+}
+
+/* `cnt` counts the calling thread, which works alongside the others. */
+bool workers_start(struct workers *wk, const int cnt)
+{
+        wk->cnt = (cnt < 1) ? 1 : (cnt > WORKERS_MAX) ? WORKERS_MAX : cnt;
+        wk->gen = 0;
+        wk->busy = 0;
+        wk->quit = false;
+        pthread_mutex_init(&wk->lock, NULL);
+        pthread_cond_init(&wk->wake, NULL);
+        pthread_cond_init(&wk->done, NULL);
+        for (int i = 1; i < wk->cnt; ++i) {
+                wk->thread_args[i].wk = wk;
+                wk->thread_args[i].self = i;
+                if (pthread_create(wk->threads + i, NULL, workers_main,
+                                   wk->thread_args + i)) {
+                        wk->cnt = i;
+                        workers_stop(wk);
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+void workers_stop(struct workers *wk)
+{
+        pthread_mutex_lock(&wk->lock);
+        wk->quit = true;
+        pthread_cond_broadcast(&wk->wake);
+        pthread_mutex_unlock(&wk->lock);
+        for (int i = 1; i < wk->cnt; ++i)
+                pthread_join(wk->threads[i], NULL);
+
+        pthread_cond_destroy(&wk->done);
+        pthread_cond_destroy(&wk->wake);
+        pthread_mutex_destroy(&wk->lock);
+        wk->cnt = 0;
+}
+
+/*
+ * Calls `fn` over [0, item_cnt) in chunks of `chunk_size` and returns once
+ * all of them are done. Which thread gets a chunk varies from run to run,
+ * so `fn` must only write to state owned by the items it was given.
+ */
+void workers_run(struct workers *wk, workers_fn fn, void *arg,
+                 const uint32_t item_cnt, const uint32_t chunk_size)
+{
+        uint32_t chunk_cnt, first;
+
+        chunk_cnt = (item_cnt + chunk_size - 1) / chunk_size;
+        if (wk->cnt <= 1 || chunk_cnt <= 1) {
+                if (item_cnt)
+                        fn(arg, 0, item_cnt);
+
+                return;
+        }
+
+        first = 0;
+        for (int i = 0; i < wk->cnt; ++i) {
+                uint32_t cnt;
+
+                cnt = chunk_cnt / wk->cnt + ((uint32_t)i < chunk_cnt % wk->cnt);
+                wk->queues[i].head = first;
+                wk->queues[i].end = first + cnt;
+                first += cnt;
+        }
+
+        pthread_mutex_lock(&wk->lock);
+        wk->fn = fn;
+        wk->arg = arg;
+        wk->item_cnt = item_cnt;
+        wk->chunk_size = chunk_size;
+        wk->busy = wk->cnt - 1;
+        ++wk->gen;
+        pthread_cond_broadcast(&wk->wake);
+        pthread_mutex_unlock(&wk->lock);
+
+        workers_drain(wk, 0);
+
+        pthread_mutex_lock(&wk->lock);
+        while (wk->busy)
+                pthread_cond_wait(&wk->done, &wk->lock);
+
+        pthread_mutex_unlock(&wk->lock);
+}
+
+#endif /* COLLISION_THREADS */
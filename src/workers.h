@@ -0,0 +1,56 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+/*
+ * Host builds only (simulation servers, offline tools): libdragon has no
+ * threads, so define COLLISION_THREADS and link with -lpthread.
+ */
+#ifdef COLLISION_THREADS
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WORKERS_MAX 8 /* Including the thread that calls workers_run() */
+
+typedef void (*workers_fn)(void *arg, const uint32_t first,
+                           const uint32_t cnt);
+
+/* Chunks [head, end) not yet claimed, by the owner or by a thief. */
+struct workers_queue {
+        uint32_t head;
+        uint32_t end;
+} __attribute__((aligned(64)));
+
+struct workers;
+
+struct workers_thread {
+        struct workers *wk;
+        int self; /* Which queue it drains first */
+};
+
+struct workers {
+        struct workers_queue queues[WORKERS_MAX];
+        pthread_t threads[WORKERS_MAX];
+        struct workers_thread thread_args[WORKERS_MAX];
+        int cnt;
+        pthread_mutex_t lock;
+        pthread_cond_t wake;
+        pthread_cond_t done;
+        uint32_t gen; /* Bumped per run, threads wait for it to change */
+        int busy; /* Threads still working on this run */
+        bool quit;
+        workers_fn fn;
+        void *arg;
+        uint32_t item_cnt;
+        uint32_t chunk_size;
+};
+
+bool workers_start(struct workers *wk, const int cnt);
+void workers_stop(struct workers *wk);
+void workers_run(struct workers *wk, workers_fn fn, void *arg,
+                 const uint32_t item_cnt, const uint32_t chunk_size);
+
+#endif /* COLLISION_THREADS */
+
+#endif /* WORKERS_H */
@@ -0,0 +1,407 @@
+#include <libdragon.h>
+
+#include "clip.h"
+#include "max_dot.h"
+#include "narrowphase.h"
+#include "world.h"
+
+#define WORLD_PAIR_KEY(A, B) (((uint32_t)(A) << 16) | (B))
+
+struct world world_create(const struct world_config *cfg, struct arena *ar)
+{
+        struct world w;
+
+        w.cfg = *cfg;
+        w.bodies = arena_alloc(ar, sizeof(*w.bodies) * cfg->body_cap);
+        w.shapes = arena_alloc(ar, sizeof(*w.shapes) * cfg->body_cap);
+        w.body_cnt = 0;
+        w.islands = arena_alloc(ar, sizeof(*w.islands) * cfg->body_cap);
+        w.island_busy = arena_alloc(ar, sizeof(*w.island_busy) *
+                                    cfg->body_cap);
+        w.island_ids = arena_alloc(ar, sizeof(*w.island_ids) *
+                                   cfg->body_cap);
+        w.island_next = 0;
+        w.bp = broadphase_create(cfg->body_cap, ar);
+        w.mins = arena_alloc(ar, sizeof(*w.mins) * cfg->body_cap);
+        w.maxs = arena_alloc(ar, sizeof(*w.maxs) * cfg->body_cap);
+        w.pairs = pool_create(sizeof(struct broadphase_pair), cfg->pair_cap,
+                              ar);
+        for (int i = 0; i < 2; ++i)
+                w.caches[i] = pool_create(sizeof(struct world_pair_cache),
+                                          cfg->cache_cap, ar);
+
+        w.cache_cur = 0;
+        w.contacts = pool_create(sizeof(struct world_contact),
+                                 cfg->contact_cap, ar);
+        w.rows = pool_create(sizeof(struct solver_row), cfg->contact_cap, ar);
+#ifdef COLLISION_THREADS
+        w.workers = NULL;
+#endif
+
+        return w;
+}
+
+/* Sweep order isn't key order, so sort before merging with the caches. */
+static void world_sort_pairs(struct pool *pairs)
+{
+        struct broadphase_pair *p;
+
+        p = pool_get(pairs, 0);
+        for (uint32_t i = 1; i < pairs->cnt; ++i) {
+                struct broadphase_pair tmp;
+                uint32_t key;
+                int j;
+
+                tmp = p[i];
+                key = WORLD_PAIR_KEY(tmp.a, tmp.b);
+                for (j = i - 1; j >= 0 &&
+                     WORLD_PAIR_KEY(p[j].a, p[j].b) > key; --j)
+                        p[j + 1] = p[j];
+
+                p[j + 1] = tmp;
+        }
+}
+
+/*
+ * Walks this tick's sorted pairs alongside last tick's sorted caches,
+ * carrying over the ones that persist and starting fresh for new pairs.
+ * Pairs that stopped overlapping are simply not copied.
+ */
+static void world_merge_caches(struct world *w)
+{
+        const struct pool *old;
+        struct pool *new;
+        uint32_t j;
+
+        old = w->caches + w->cache_cur;
+        w->cache_cur ^= 1;
+        new = w->caches + w->cache_cur;
+        pool_clear(new);
+
+        j = 0;
+        for (uint32_t i = 0; i < w->pairs.cnt; ++i) {
+                const struct broadphase_pair *p;
+                struct world_pair_cache *c;
+                const struct world_pair_cache *prev;
+                uint32_t key;
+
+                p = pool_get(&w->pairs, i);
+                key = WORLD_PAIR_KEY(p->a, p->b);
+                prev = NULL;
+                for (; j < old->cnt; ++j) {
+                        const struct world_pair_cache *o;
+
+                        o = pool_get(old, j);
+                        if (o->key >= key) {
+                                if (o->key == key)
+                                        prev = o;
+
+                                break;
+                        }
+                }
+
+                c = pool_push(new);
+                if (!c)
+                        continue;
+
+                if (prev) {
+                        *c = *prev;
+                } else {
+                        c->key = key;
+                        c->gjk.valid = false;
+                        manifold_init(&c->manifold);
+                }
+        }
+}
+
+/* Returns the body's index, or -1 once `body_cap` is reached. */
+int world_add_body(struct world *w, const struct body *b)
+{
+        if (w->body_cnt >= w->cfg.body_cap)
+                return -1;
+
+        w->bodies[w->body_cnt] = *b;
+        w->shapes[w->body_cnt] = body_get_shape(w->bodies + w->body_cnt);
+        shape_get_bounds(w->mins + w->body_cnt, w->maxs + w->body_cnt,
+                         w->shapes + w->body_cnt);
+
+        return w->body_cnt++;
+}
+
+/* For kinematic bodies, and teleporting dynamic ones. */
+void world_set_body_pos(struct world *w, const uint16_t i,
+                        const T3DVec3 *pos)
+{
+        struct body *b;
+
+        b = w->bodies + i;
+        if (!memcmp(&b->pos, pos, sizeof(*pos)))
+                return;
+
+        b->pos = *pos;
+        b->moved = true;
+        world_wake_body(w, i);
+}
+
+/* Sleeping islands wake as a whole, or the rest would hang in the air. */
+void world_wake_body(struct world *w, const uint16_t i)
+{
+        uint32_t island;
+
+        if (!w->bodies[i].asleep)
+                return;
+
+        island = w->bodies[i].island;
+        for (uint16_t j = 0; j < w->body_cnt; ++j)
+                if (w->bodies[j].asleep && w->bodies[j].island == island)
+                        body_wake(w->bodies + j);
+}
+
+/*
+ * Narrowphase and manifold update for caches [first, first + cnt). Bodies
+ * and shapes are only read and each cache only touched by its own job, so
+ * chunks can run on any thread in any order.
+ */
+static void world_collide_pairs(void *arg, const uint32_t first,
+                                const uint32_t cnt)
+{
+        const struct shape *shapes;
+        struct world *w;
+        struct pool *caches;
+
+        w = arg;
+        shapes = w->shapes;
+        caches = w->caches + w->cache_cur;
+        for (uint32_t i = first; i < first + cnt; ++i) {
+                struct contact c, clipped[CLIP_VERT_MAX];
+                struct world_pair_cache *pc;
+                int clip_cnt;
+                uint16_t a, b;
+                bool hit;
+
+                pc = pool_get(caches, i);
+                a = pc->key >> 16;
+                b = pc->key & 0xFFFF;
+                pc->live = false;
+                if (!w->bodies[a].inv_mass && !w->bodies[b].inv_mass)
+                        continue;
+
+                /* Nothing moved on either side, the manifold still holds. */
+                if (!body_is_active(w->bodies + a) &&
+                    !body_is_active(w->bodies + b))
+                        continue;
+
+                pc->live = true;
+                hit = narrowphase_collide_cached(&c, shapes + a, shapes + b,
+                                                 &pc->gjk);
+                clip_cnt = (hit) ? clip_contacts(clipped, CLIP_VERT_MAX, &c,
+                                                 shapes + a, shapes + b) : 0;
+                if (clip_cnt)
+                        manifold_set(&pc->manifold, clipped, clip_cnt,
+                                     shapes + a, shapes + b);
+                else
+                        manifold_update(&pc->manifold, (hit) ? &c : NULL,
+                                        shapes + a, shapes + b);
+        }
+}
+
+/*
+ * Broadphase, pair cache upkeep, then one narrowphase query per pair. Pairs
+ * with flat faces get their manifold rebuilt by clipping, the rest fold the
+ * single point in. Every manifold point becomes an entry in `contacts`.
+ */
+static void world_collide(struct world *w)
+{
+        struct pool *caches;
+
+        /* Sleeping and static bodies keep last step's shape and bounds. */
+        for (uint16_t i = 0; i < w->body_cnt; ++i) {
+                if (!body_is_active(w->bodies + i))
+                        continue;
+
+                w->shapes[i] = body_get_shape(w->bodies + i);
+                shape_get_bounds(w->mins + i, w->maxs + i, w->shapes + i);
+        }
+
+        pool_clear(&w->pairs);
+        broadphase_update(&w->bp, &w->pairs, w->mins, w->maxs,
+                          w->body_cnt);
+        world_sort_pairs(&w->pairs);
+        world_merge_caches(w);
+
+        caches = w->caches + w->cache_cur;
+#ifdef COLLISION_THREADS
+        if (w->workers)
+                workers_run(w->workers, world_collide_pairs, w, caches->cnt,
+                            WORLD_PAIR_CHUNK);
+        else
+#endif
+                world_collide_pairs(w, 0, caches->cnt);
+
+        /* Serially and in key order, whatever thread ran each pair. */
+        pool_clear(&w->contacts);
+        for (uint32_t i = 0; i < caches->cnt; ++i) {
+                struct world_pair_cache *pc;
+                uint16_t a, b;
+
+                pc = pool_get(caches, i);
+                if (!pc->live || !pc->manifold.cnt)
+                        continue;
+
+                a = pc->key >> 16;
+                b = pc->key & 0xFFFF;
+                world_wake_body(w, a);
+                world_wake_body(w, b);
+                for (int j = 0; j < pc->manifold.cnt; ++j) {
+                        struct world_contact *wc;
+
+                        wc = pool_push(&w->contacts);
+                        if (!wc)
+                                break;
+
+                        wc->a = a;
+                        wc->b = b;
+                        wc->mp = pc->manifold.pts + j;
+                        manifold_get_contact(&wc->c, &pc->manifold, j,
+                                             w->shapes + a, w->shapes + b);
+                }
+        }
+}
+
+#ifdef COLLISION_THREADS
+/* Pairs from each step are spread over `wk`, NULL goes back to inline. */
+void world_set_workers(struct world *w, struct workers *wk)
+{
+        /* Pick the support kernel now rather than racing to on first use. */
+        max_dot_get_impl();
+        w->workers = wk;
+}
+#endif
+
+static uint16_t world_island_find(uint16_t *islands, uint16_t i)
+{
+        while (islands[i] != i) {
+                islands[i] = islands[islands[i]];
+                i = islands[i];
+        }
+
+        return i;
+}
+
+/*
+ * Joins dynamic bodies that touch into islands; static and kinematic ones
+ * don't join, or the whole level would be one island. An island sleeps
+ * once every body in it has been at rest long enough, and anything a
+ * kinematic body is pushing stays awake.
+ */
+static void world_update_islands(struct world *w, const float dt)
+{
+        for (uint16_t i = 0; i < w->body_cnt; ++i) {
+                w->islands[i] = i;
+                w->island_busy[i] = false;
+                w->island_ids[i] = 0;
+        }
+
+        for (uint32_t i = 0; i < w->contacts.cnt; ++i) {
+                const struct world_contact *wc;
+                uint16_t ra, rb;
+
+                wc = pool_get(&w->contacts, i);
+                if (!w->bodies[wc->a].inv_mass || !w->bodies[wc->b].inv_mass)
+                        continue;
+
+                ra = world_island_find(w->islands, wc->a);
+                rb = world_island_find(w->islands, wc->b);
+                w->islands[ra] = rb;
+        }
+
+        for (uint16_t i = 0; i < w->body_cnt; ++i) {
+                struct body *b;
+                uint16_t root;
+
+                b = w->bodies + i;
+                if (!b->inv_mass || b->asleep)
+                        continue;
+
+                body_update_sleep_time(b, dt);
+                root = world_island_find(w->islands, i);
+                if (b->sleep_time < BODY_SLEEP_TIME)
+                        w->island_busy[root] = true;
+        }
+
+        for (uint32_t i = 0; i < w->contacts.cnt; ++i) {
+                const struct world_contact *wc;
+
+                wc = pool_get(&w->contacts, i);
+                if (w->bodies[wc->a].moved)
+                        w->island_busy[world_island_find(w->islands,
+                                                         wc->b)] = true;
+
+                if (w->bodies[wc->b].moved)
+                        w->island_busy[world_island_find(w->islands,
+                                                         wc->a)] = true;
+        }
+
+        for (uint16_t i = 0; i < w->body_cnt; ++i) {
+                struct body *b;
+                uint16_t root;
+
+                b = w->bodies + i;
+                b->moved = false;
+                if (!b->inv_mass || b->asleep)
+                        continue;
+
+                /*
+                 * Roots are only unique within this step, so each island
+                 * gets a fresh id or it could share one with another that
+                 * went to sleep earlier.
+                 */
+                root = world_island_find(w->islands, i);
+                if (w->island_busy[root])
+                        continue;
+
+                if (!w->island_ids[root])
+                        w->island_ids[root] = ++w->island_next;
+
+                body_sleep(b, w->island_ids[root]);
+        }
+}
+
+void world_step(struct world *w, const float dt)
+{
+        for (uint16_t i = 0; i < w->body_cnt; ++i)
+                body_integrate_velocity(w->bodies + i, dt);
+
+        world_collide(w);
+
+        pool_clear(&w->rows);
+        for (uint32_t i = 0; i < w->contacts.cnt; ++i) {
+                struct world_contact *wc;
+
+                wc = pool_get(&w->contacts, i);
+                solver_add(&w->rows, w->bodies, wc->a, wc->b, &wc->c, wc->mp,
+                           dt);
+        }
+
+        solver_solve(&w->rows, w->bodies, SOLVER_ITER_CNT);
+        for (uint16_t i = 0; i < w->body_cnt; ++i)
+                body_integrate_position(w->bodies + i, dt);
+
+        world_update_islands(w, dt);
+}
+
+uint16_t world_get_awake_cnt(const struct world *w)
+{
+        uint16_t cnt;
+
+        cnt = 0;
+        for (uint16_t i = 0; i < w->body_cnt; ++i)
+                cnt += (w->bodies[i].inv_mass && !w->bodies[i].asleep);
+
+        return cnt;
+}
+
+const struct pool *world_get_caches(const struct world *w)
+{
+        return w->caches + w->cache_cur;
+}
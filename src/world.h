@@ -0,0 +1,80 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "body.h"
+#include "broadphase.h"
+#include "contact.h"
+#include "gjk.h"
+#include "manifold.h"
+#include "pool.h"
+#include "shape.h"
+#include "solver.h"
+#include "workers.h"
+
+#define WORLD_PAIR_CHUNK 16 /* Pairs per narrowphase job when threaded */
+
+/* Per-level sizing, everything is allocated once in world_create(). */
+struct world_config {
+        uint16_t body_cap;
+        uint32_t pair_cap;
+        uint32_t cache_cap;
+        uint32_t contact_cap;
+};
+
+#define WORLD_CONFIG_DEFAULT ((struct world_config){ \
+        .body_cap = 16,                              \
+        .pair_cap = 64,                              \
+        .cache_cap = 64,                             \
+        .contact_cap = 128                           \
+})
+
+/* State carried from one tick to the next for a pair that still overlaps. */
+struct world_pair_cache {
+        uint32_t key; /* a << 16 | b, caches are kept sorted by it */
+        struct gjk_cache gjk;
+        struct manifold manifold;
+        bool live; /* Went through the narrowphase this step */
+};
+
+struct world_contact {
+        uint16_t a;
+        uint16_t b;
+        struct contact c;
+        struct manifold_point *mp; /* Valid until the next step */
+};
+
+struct world {
+        struct world_config cfg;
+        struct body *bodies;
+        struct shape *shapes; /* Rebuilt from `bodies` that moved */
+        uint16_t body_cnt;
+        uint16_t *islands; /* Union-find parents over this step's contacts */
+        bool *island_busy; /* Per root, something in it can't sleep yet */
+        uint32_t *island_ids; /* Per root, the id it went to sleep under */
+        uint32_t island_next; /* Last sleep id handed out, never reused */
+        struct broadphase bp;
+        T3DVec3 *mins;
+        T3DVec3 *maxs;
+        struct pool pairs; /* struct broadphase_pair */
+        struct pool caches[2]; /* struct world_pair_cache, swapped per tick */
+        int cache_cur;
+        struct pool contacts; /* struct world_contact */
+        struct pool rows; /* struct solver_row */
+#ifdef COLLISION_THREADS
+        struct workers *workers; /* Optional, NULL runs it all inline */
+#endif
+};
+
+struct world world_create(const struct world_config *cfg, struct arena *ar);
+int world_add_body(struct world *w, const struct body *b);
+void world_set_body_pos(struct world *w, const uint16_t i,
+                        const T3DVec3 *pos);
+void world_wake_body(struct world *w, const uint16_t i);
+#ifdef COLLISION_THREADS
+void world_set_workers(struct world *w, struct workers *wk);
+#endif
+void world_step(struct world *w, const float dt);
+uint16_t world_get_awake_cnt(const struct world *w);
+const struct pool *world_get_caches(const struct world *w);
+
+#endif /* WORLD_H */
@@ -0,0 +1,118 @@
+#ifndef CACHE_C
+#define CACHE_C
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+
+/*
+ * The Makefile passes a hash of the tool's sources, so any change to them
+ * misses the cache. Bump this one if building without it.
+ */
+#ifndef CACHE_TOOL_VERSION
+#define CACHE_TOOL_VERSION "gltf-to-coldat 6"
+#endif
+#define CACHE_EXT ".cache"
+
+#define CACHE_FNV_OFFSET 0xCBF29CE484222325ull
+#define CACHE_FNV_PRIME 0x100000001B3ull
+
+/*
+ * The sidecar `name.cm.cache` holds the tool version and a hash of the
+ * options and geometry the mesh was built from. Anything else in the glTF
+ * (materials, UVs, animation) doesn't reach the .cm, so it doesn't reach
+ * the hash.
+ */
+static uint64_t cache_hash_bytes(uint64_t h, const void *data,
+                                 const size_t sz)
+{
+        const uint8_t *p;
+
+        p = data;
+        for (size_t i = 0; i < sz; ++i) {
+                h ^= p[i];
+                h *= CACHE_FNV_PRIME;
+        }
+
+        return h;
+}
+
+static uint64_t cache_hash_mesh(const struct collision_mesh *cm,
+                                const struct convert_opts *opts)
+{
+        uint64_t h;
+
+        h = cache_hash_bytes(CACHE_FNV_OFFSET, CACHE_TOOL_VERSION,
+                             sizeof(CACHE_TOOL_VERSION));
+        h = cache_hash_bytes(h, &opts->concavity, sizeof(opts->concavity));
+        h = cache_hash_bytes(h, &opts->hull_max, sizeof(opts->hull_max));
+        h = cache_hash_bytes(h, &opts->weld, sizeof(opts->weld));
+        h = cache_hash_bytes(h, &opts->tri_max, sizeof(opts->tri_max));
+        h = cache_hash_bytes(h, &opts->vert_max, sizeof(opts->vert_max));
+        h = cache_hash_bytes(h, &cm->tri_cnt, sizeof(cm->tri_cnt));
+        h = cache_hash_bytes(h, cm->tris, sizeof(*cm->tris) * cm->tri_cnt);
+        h = cache_hash_bytes(h, &cm->piece_cnt, sizeof(cm->piece_cnt));
+
+        return cache_hash_bytes(h, cm->pieces,
+                                sizeof(*cm->pieces) * cm->piece_cnt);
+}
+
+static char *cache_get_path(const char *cm_path)
+{
+        size_t len;
+        char *path;
+
+        len = strlen(cm_path);
+        path = malloc(len + sizeof(CACHE_EXT));
+        memcpy(path, cm_path, len);
+        memcpy(path + len, CACHE_EXT, sizeof(CACHE_EXT));
+
+        return path;
+}
+
+/*
+ * True if the output is already up to date. It gets its timestamp bumped
+ * so Make sees it as rebuilt from the newer glTF.
+ */
+static bool cache_check(const char *cm_path, const uint64_t hash)
+{
+        char *path, line[64];
+        uint64_t prev;
+        bool hit;
+        FILE *f;
+
+        path = cache_get_path(cm_path);
+        f = fopen(path, "r");
+        free(path);
+        if (!f)
+                return false;
+
+        hit = fgets(line, sizeof(line), f) &&
+              !strncmp(line, CACHE_TOOL_VERSION "\n", sizeof(line)) &&
+              fscanf(f, "%" SCNx64, &prev) == 1 && prev == hash;
+        fclose(f);
+        if (!hit)
+                return false;
+
+        return !utimensat(AT_FDCWD, cm_path, NULL, 0);
+}
+
+static bool cache_write(const char *cm_path, const uint64_t hash)
+{
+        char *path;
+        FILE *f;
+
+        path = cache_get_path(cm_path);
+        f = fopen(path, "w");
+        free(path);
+        if (!f)
+                return false;
+
+        fprintf(f, "%s\n%016" PRIx64 "\n", CACHE_TOOL_VERSION, hash);
+        fclose(f);
+
+        return true;
+}
+
+#endif /* CACHE_C */
@@ -3,146 +3,376 @@
 
 #include <stdbool.h>
 
+static void collision_mesh_init(struct collision_mesh *cm)
+{
+        cm->tri_cnt = 0;
+        cm->tris = NULL;
+        cm->piece_cnt = 0;
+        cm->pieces = NULL;
+}
+
+static void collision_mesh_free(struct collision_mesh *cm)
+{
+        free(cm->tris);
+        free(cm->pieces);
+        collision_mesh_init(cm);
+}
+
+/*
+ * Element `i` of `acc`, straight out of whichever buffer its view is in,
+ * with the accessor's own offset and stride so interleaved vertex data
+ * works as is.
+ */
+static const uint8_t *gltf_accessor_get_elem(const cgltf_accessor *acc,
+                                             const size_t i)
+{
+        return cgltf_buffer_view_data(acc->buffer_view) + acc->offset +
+               i * acc->stride;
+}
+
+/* Whether every element of `acc` lies inside its buffer view. */
+static bool gltf_accessor_is_readable(const cgltf_accessor *acc)
+{
+        cgltf_size elem_sz;
+
+        if (!acc->buffer_view || acc->is_sparse ||
+            !cgltf_buffer_view_data(acc->buffer_view))
+                return false;
+
+        if (!acc->count)
+                return true;
+
+        elem_sz = cgltf_calc_size(acc->type, acc->component_type);
+
+        return acc->offset + (acc->count - 1) * acc->stride + elem_sz <=
+               acc->buffer_view->size;
+}
+
+static bool gltf_accessor_is_index(const cgltf_accessor *acc)
+{
+        return acc->type == cgltf_type_scalar &&
+               (acc->component_type == cgltf_component_type_r_8u ||
+                acc->component_type == cgltf_component_type_r_16u ||
+                acc->component_type == cgltf_component_type_r_32u);
+}
+
+static uint32_t gltf_accessor_get_index(const cgltf_accessor *acc,
+                                        const size_t i)
+{
+        const uint8_t *p;
+        uint16_t v16;
+        uint32_t v32;
+
+        p = gltf_accessor_get_elem(acc, i);
+        switch (acc->component_type) {
+                case cgltf_component_type_r_8u:
+                        return *p;
+
+                case cgltf_component_type_r_16u:
+                        memcpy(&v16, p, sizeof(v16));
+                        return v16;
+
+                default:
+                        memcpy(&v32, p, sizeof(v32));
+                        return v32;
+        }
+}
+
+static const cgltf_accessor *gltf_prim_get_pos(const cgltf_primitive *prim)
+{
+        for (size_t i = 0; i < prim->attributes_count; ++i)
+                if (prim->attributes[i].type == cgltf_attribute_type_position)
+                        return prim->attributes[i].data;
+
+        return NULL;
+}
+
+/* Most triangles `prim` can give, before anything's checked. */
+static size_t gltf_prim_get_tri_bound(const cgltf_primitive *prim)
+{
+        const cgltf_accessor *pos_acc;
+
+        if (prim->type != cgltf_primitive_type_triangles)
+                return 0;
+
+        if (prim->indices)
+                return prim->indices->count / 3;
+
+        pos_acc = gltf_prim_get_pos(prim);
+
+        return (pos_acc) ? pos_acc->count / 3 : 0;
+}
+
+/*
+ * Deindexes `prim` onto the end of `cm`, which already has room for it,
+ * reading positions and indices where they lie in the mapped buffers.
+ * Nothing is added if the primitive can't be read, `path` says where.
+ */
 static void collision_mesh_from_gltf_prim(struct collision_mesh *cm,
-                                          const cgltf_data *gltf,
-                                          const void *bin,
-                                          const cgltf_primitive *prim)
-{
-        cgltf_buffer_view *indi_bv, *pos_bv;
-        uint16_t *indi_buf;
-        float *pos_buf_raw, *pos_buf;
-        int indi_cnt;
-
-        /* Rip indices */
-        indi_bv = prim->indices->buffer_view;
-        if (!indi_bv) {
-                printf("ERROR: Couldn't find indices buffer view in prim.\n");
+                                          const cgltf_primitive *prim,
+                                          const char *path)
+{
+        const cgltf_accessor *indi_acc, *pos_acc;
+        struct triangle *tris;
+        size_t indi_cnt;
+
+        if (prim->type != cgltf_primitive_type_triangles) {
+                printf("ERROR: Prim in '%s' isn't a triangle list.\n",
+                       path);
+                return;
+        }
+
+        /* Find positions, through the attribute's own accessor */
+        pos_acc = gltf_prim_get_pos(prim);
+        if (!pos_acc || !gltf_accessor_is_readable(pos_acc) ||
+            pos_acc->type != cgltf_type_vec3 ||
+            pos_acc->component_type != cgltf_component_type_r_32f) {
+                printf("ERROR: Couldn't find float positions in prim in "
+                       "'%s'.\n", path);
+                return;
+        }
+
+        /* Indices of 8, 16 or 32 bits, or none for a plain triangle list */
+        indi_acc = prim->indices;
+        if (indi_acc && (!gltf_accessor_is_readable(indi_acc) ||
+                         !gltf_accessor_is_index(indi_acc))) {
+                printf("ERROR: Couldn't read indices in prim in '%s'.\n",
+                       path);
                 return;
         }
 
-        indi_buf = malloc(indi_bv->size);
-        memcpy(indi_buf, bin + indi_bv->offset, indi_bv->size);
-        indi_cnt = indi_bv->size >> 1;
+        indi_cnt = (indi_acc) ? indi_acc->count : pos_acc->count;
 
-        /* Rip raw positions */
-        pos_bv = NULL;
-        for (size_t i = 0; i < prim->attributes_count; ++i) {
-                cgltf_attribute_type at;
+        /* Deindex straight into the collision mesh */
+        tris = cm->tris + cm->tri_cnt;
+        for (size_t i = 0; i < indi_cnt / 3 * 3; ++i) {
+                uint32_t ind;
 
-                at = prim->attributes[i].type;
-                if (at == cgltf_attribute_type_position) {
-                        pos_bv = gltf->buffer_views + i;
-                        break;
+                ind = (indi_acc) ? gltf_accessor_get_index(indi_acc, i) : i;
+                if (ind >= pos_acc->count) {
+                        printf("ERROR: Index %u out of range in prim in "
+                               "'%s'.\n", ind, path);
+                        return;
                 }
-        }
 
-        if (!pos_bv) {
-                printf("ERROR: Couldn't find position buffer view in prim.\n");
-                return;
+                memcpy(tris[i / 3].p[i % 3].v,
+                       gltf_accessor_get_elem(pos_acc, ind),
+                       sizeof(float) * 3);
         }
 
-        pos_buf_raw = malloc(pos_bv->size);
-        memcpy(pos_buf_raw, bin + pos_bv->offset, pos_bv->size);
+        cm->tri_cnt += indi_cnt / 3;
+}
 
-        /* Unwrap/deindex vertices */
-        pos_buf = malloc(indi_cnt * sizeof(float) * 3);
-        for (int i = 0; i < indi_cnt; ++i) {
-                float *src, *dst;
+/* Moves the triangles of `src` onto the end of `dst`. */
+static void collision_mesh_append(struct collision_mesh *dst,
+                                  struct collision_mesh *src)
+{
+        size_t sz;
 
-                src = pos_buf_raw + (indi_buf[i] * 3);
-                dst = pos_buf + (i * 3);
-                memcpy(dst, src, sizeof(float) * 3);
+        sz = sizeof(*dst->tris) * (dst->tri_cnt + src->tri_cnt);
+        if (src->tri_cnt) {
+                dst->tris = realloc(dst->tris, sz);
+                memcpy(dst->tris + dst->tri_cnt, src->tris,
+                       src->tri_cnt * sizeof(*src->tris));
+                dst->tri_cnt += src->tri_cnt;
         }
 
-        /* Populate collision mesh */
-        cm->tri_cnt = indi_cnt / 3;
-        cm->tris = malloc(sizeof(*cm->tris) * cm->tri_cnt);
-        memcpy(cm->tris, pos_buf, sizeof(*cm->tris) * cm->tri_cnt);
+        collision_mesh_free(src);
+}
 
-        /* Exit */
-        free(pos_buf);
-        free(pos_buf_raw);
-        free(indi_buf);
+static void collision_mesh_push_piece(struct collision_mesh *cm,
+                                      const uint32_t first,
+                                      const uint32_t cnt,
+                                      const uint32_t flags)
+{
+        struct collision_piece *p;
+
+        cm->pieces = realloc(cm->pieces,
+                             sizeof(*cm->pieces) * (cm->piece_cnt + 1));
+        p = cm->pieces + cm->piece_cnt++;
+        p->first = first;
+        p->cnt = cnt;
+        p->flags = flags;
 }
 
-static void collision_mesh_free(struct collision_mesh *cm)
+/* Column-major, as glTF stores them. */
+static void mat4_mul_point(float *out, const float *m, const float *p)
 {
-        cm->tri_cnt = 0;
-        free(cm->tris);
-        cm->tris = NULL;
+        for (int i = 0; i < 3; ++i)
+                out[i] = m[i] * p[0] + m[4 + i] * p[1] + m[8 + i] * p[2] +
+                         m[12 + i];
 }
 
-static void collision_mesh_stitch(struct collision_mesh *dst,
-                                  struct collision_mesh *src_arr,
-                                  const int src_cnt)
+static float mat4_det3(const float *m)
 {
-        dst->tri_cnt = 0;
-        dst->tris = NULL;
+        return m[0] * (m[5] * m[10] - m[9] * m[6]) -
+               m[4] * (m[1] * m[10] - m[9] * m[2]) +
+               m[8] * (m[1] * m[6] - m[5] * m[2]);
+}
 
-        for (int i = 0; i < src_cnt; ++i) {
-                struct collision_mesh *src = src_arr + i;
-                size_t sz;
-                int off_cnt;
+/*
+ * Every primitive of the node's mesh onto the end of `cm`, in world
+ * space. Mirroring transforms flip the winding back so faces still point
+ * outwards.
+ */
+static void collision_mesh_from_gltf_node(struct collision_mesh *cm,
+                                          const cgltf_node *node,
+                                          const char *path)
+{
+        float world[16];
+        uint32_t first;
+        bool flip;
+
+        cgltf_node_transform_world(node, world);
+        flip = mat4_det3(world) < 0.f;
+        first = cm->tri_cnt;
+        for (size_t i = 0; i < node->mesh->primitives_count; ++i)
+                collision_mesh_from_gltf_prim(cm, node->mesh->primitives + i,
+                                              path);
+
+        for (uint32_t i = first; i < cm->tri_cnt; ++i) {
+                struct triangle *t;
+
+                t = cm->tris + i;
+                for (int k = 0; k < 3; ++k) {
+                        float v[3];
+
+                        mat4_mul_point(v, world, t->p[k].v);
+                        memcpy(t->p[k].v, v, sizeof(v));
+                }
 
-                off_cnt = dst->tri_cnt;
-                dst->tri_cnt += src->tri_cnt;
-                sz = sizeof(*dst->tris) * dst->tri_cnt;
-                if (!dst->tris)
-                        dst->tris = malloc(sz);
-                else
-                        dst->tris = realloc(dst->tris, sz);
+                if (flip) {
+                        struct point tmp;
 
-                memcpy(dst->tris + off_cnt, src->tris,
-                       src->tri_cnt * sizeof(*src->tris));
-                collision_mesh_free(src);
+                        tmp = t->p[1];
+                        t->p[1] = t->p[2];
+                        t->p[2] = tmp;
+                }
         }
 }
 
-static void gltf_data_to_collision_mesh(struct collision_mesh *cm,
-                                        const cgltf_data *gltf,
-                                        const void *bin)
+static bool gltf_node_is_piece(const cgltf_node *node)
 {
-        cgltf_mesh *mesh_main;
-        cgltf_primitive *prims;
-        struct collision_mesh *cm_tmp;
-        int cm_tmp_cnt;
+        return node->name && !strncmp(node->name, COLLISION_PIECE_PREFIX,
+                                      strlen(COLLISION_PIECE_PREFIX));
+}
 
-        if (gltf->meshes_count < 1) {
-                printf("NO MESHES FOUND IN FILE!\n");
-                return;
-        }
+/* Room the static mesh and the pieces under `node` need, at most. */
+static void gltf_node_count(const cgltf_node *node, size_t *merged_cnt,
+                            size_t *piece_cnt)
+{
+        if (node->mesh) {
+                size_t cnt;
 
-        if (gltf->meshes_count > 1) {
-                printf("MORE THAN 1 MESH IN FILE! UNIMPLEMENTED!\n");
-                return;
-        }
+                cnt = 0;
+                for (size_t i = 0; i < node->mesh->primitives_count; ++i)
+                        cnt += gltf_prim_get_tri_bound(node->mesh->primitives +
+                                                       i);
 
-        mesh_main = gltf->meshes + 0;
-        if (!mesh_main) {
-                printf("MAIN MESH POINTER IS INVALID!\n");
-                return;
+                if (gltf_node_is_piece(node))
+                        *piece_cnt += cnt;
+                else
+                        *merged_cnt += cnt;
         }
 
-        if (mesh_main->primitives_count < 1) {
-                printf("NO PRIMITIVES IN MAIN MESH!\n");
-                return;
+        for (size_t i = 0; i < node->children_count; ++i)
+                gltf_node_count(node->children[i], merged_cnt, piece_cnt);
+}
+
+/*
+ * Depth first, so pieces come out in the order they appear in the scene.
+ * `col_*` nodes each become their own piece, the rest merge together.
+ */
+static void gltf_node_walk(struct collision_mesh *merged,
+                           struct collision_mesh *pieces,
+                           const cgltf_node *node, const char *path)
+{
+        if (node->mesh && !gltf_node_is_piece(node)) {
+                collision_mesh_from_gltf_node(merged, node, path);
+        } else if (node->mesh) {
+                uint32_t first, cnt;
+
+                first = pieces->tri_cnt;
+                collision_mesh_from_gltf_node(pieces, node, path);
+                cnt = pieces->tri_cnt - first;
+                if (cnt)
+                        collision_mesh_push_piece(pieces, first, cnt,
+                                                  COLLISION_PIECE_CONVEX);
         }
 
-        cm_tmp_cnt = mesh_main->primitives_count;
-        prims = mesh_main->primitives;
-        if (!prims) {
-                printf("ERROR: Prims pointer is still NULL somehow...\n");
+        for (size_t i = 0; i < node->children_count; ++i)
+                gltf_node_walk(merged, pieces, node->children[i], path);
+}
+
+/*
+ * The static mesh goes first, then every piece after it. A file with no
+ * pieces gets no piece table at all, same as before they existed.
+ *
+ * Everything is counted first so the triangles can be written once, into
+ * their final place: the static mesh from the start of the array and the
+ * pieces from where its room ends.
+ */
+static void gltf_data_to_collision_mesh(struct collision_mesh *cm,
+                                        const cgltf_data *gltf,
+                                        const char *path)
+{
+        const cgltf_scene *scene;
+        cgltf_node **roots;
+        struct collision_mesh pieces;
+        size_t root_cnt, merged_room, piece_room;
+
+        collision_mesh_init(cm);
+        collision_mesh_init(&pieces);
+        if (gltf->meshes_count < 1) {
+                printf("NO MESHES FOUND IN '%s'!\n", path);
                 return;
         }
 
-        cm_tmp = malloc(sizeof(*cm_tmp) * cm_tmp_cnt);
-        for (int i = 0; i < cm_tmp_cnt; ++i)
-                collision_mesh_from_gltf_prim(cm_tmp + i, gltf, bin,
-                                              mesh_main->primitives + i);
+        /* Without a scene, every root node is part of it */
+        scene = (gltf->scene) ? gltf->scene :
+                (gltf->scenes_count) ? gltf->scenes : NULL;
+        if (scene) {
+                roots = scene->nodes;
+                root_cnt = scene->nodes_count;
+        } else {
+                roots = malloc(sizeof(*roots) * gltf->nodes_count);
+                root_cnt = 0;
+                for (size_t i = 0; i < gltf->nodes_count; ++i)
+                        if (!gltf->nodes[i].parent)
+                                roots[root_cnt++] = gltf->nodes + i;
+        }
 
-        collision_mesh_stitch(cm, cm_tmp, cm_tmp_cnt);
+        merged_room = 0;
+        piece_room = 0;
+        for (size_t i = 0; i < root_cnt; ++i)
+                gltf_node_count(roots[i], &merged_room, &piece_room);
+
+        cm->tris = malloc(sizeof(*cm->tris) * (merged_room + piece_room));
+        pieces.tris = cm->tris + merged_room;
+        for (size_t i = 0; i < root_cnt; ++i)
+                gltf_node_walk(cm, &pieces, roots[i], path);
+
+        if (!scene)
+                free(roots);
+
+        /* Only short if some primitive couldn't be read */
+        if (cm->tri_cnt < merged_room)
+                memmove(cm->tris + cm->tri_cnt, pieces.tris,
+                        sizeof(*pieces.tris) * pieces.tri_cnt);
+
+        if (pieces.piece_cnt) {
+                if (cm->tri_cnt)
+                        collision_mesh_push_piece(cm, 0, cm->tri_cnt, 0);
+
+                for (uint32_t i = 0; i < pieces.piece_cnt; ++i)
+                        collision_mesh_push_piece(cm, cm->tri_cnt +
+                                                  pieces.pieces[i].first,
+                                                  pieces.pieces[i].cnt,
+                                                  pieces.pieces[i].flags);
+        }
 
-        free(cm_tmp);
+        cm->tri_cnt += pieces.tri_cnt;
+        free(pieces.pieces);
 }
 
 static void collision_mesh_printf(const struct collision_mesh *cm)
@@ -151,7 +381,8 @@ static void collision_mesh_printf(const struct collision_mesh *cm)
         return;
 #endif
 
-        printf("Collision Mesh (%d Triangles):\n", cm->tri_cnt);
+        printf("Collision Mesh (%d Triangles, %d Pieces):\n", cm->tri_cnt,
+               cm->piece_cnt);
         for (size_t i = 0; i < cm->tri_cnt; ++i) {
                 printf("\tTriangle %lu:\n", i);
                 for (int j = 0; j < 3; ++j) {
@@ -182,6 +413,15 @@ static bool collision_mesh_write_to_file(const struct collision_mesh *cm,
                         for (unsigned int k = 0; k < 3; ++k)
                                 fwrite_ef32(cm->tris[i].p[j].v + k, f);
 
+        if (cm->piece_cnt)
+                fwrite_ef32(&cm->piece_cnt, f);
+
+        for (unsigned int i = 0; i < cm->piece_cnt; ++i) {
+                fwrite_ef32(&cm->pieces[i].first, f);
+                fwrite_ef32(&cm->pieces[i].cnt, f);
+                fwrite_ef32(&cm->pieces[i].flags, f);
+        }
+
         fclose(f);
 
         return true;
@@ -193,7 +433,9 @@ static bool collision_mesh_read_from_file(struct collision_mesh *cm,
                                           const char *path)
 {
         FILE *f;
+        int c;
 
+        collision_mesh_init(cm);
         if (!(f = fopen(path, "rb"))) {
                 printf("Failed to open collision mesh file from '%s'\n", path);
                 return false;
@@ -212,6 +454,18 @@ static bool collision_mesh_read_from_file(struct collision_mesh *cm,
                 }
         }
 
+        /* Files without pieces end here */
+        if ((c = fgetc(f)) != EOF) {
+                ungetc(c, f);
+                cm->piece_cnt = fread_ef32(f);
+                cm->pieces = malloc(sizeof(*cm->pieces) * cm->piece_cnt);
+                for (unsigned int i = 0; i < cm->piece_cnt; ++i) {
+                        cm->pieces[i].first = fread_ef32(f);
+                        cm->pieces[i].cnt = fread_ef32(f);
+                        cm->pieces[i].flags = fread_ef32(f);
+                }
+        }
+
         fclose(f);
 
         return true;
@@ -0,0 +1,394 @@
+#ifndef DECOMPOSE_C
+#define DECOMPOSE_C
+
+#include "hull.c"
+
+#define DECOMPOSE_CUT_CNT 7 /* Candidate planes per axis */
+
+/* A part of a piece waiting to be split or output. */
+struct decompose_part {
+        struct collision_mesh cm;
+        float concavity; /* Negative once it can't be split any further */
+};
+
+/* The caller has already made room. */
+static void decompose_push_tri(struct collision_mesh *cm, const float *a,
+                               const float *b, const float *c)
+{
+        struct triangle *t;
+
+        t = cm->tris + cm->tri_cnt++;
+        memcpy(t->p[0].v, a, sizeof(t->p[0].v));
+        memcpy(t->p[1].v, b, sizeof(t->p[1].v));
+        memcpy(t->p[2].v, c, sizeof(t->p[2].v));
+}
+
+/*
+ * Splits every triangle by the plane `axis` = `pos`, clipping those that
+ * straddle it and fanning what's left on each side back into triangles.
+ */
+static void decompose_cut(struct collision_mesh *below,
+                          struct collision_mesh *above,
+                          const struct collision_mesh *cm, const int axis,
+                          const float pos)
+{
+        collision_mesh_init(below);
+        collision_mesh_init(above);
+
+        /* A clipped triangle leaves at most a quad on each side */
+        below->tris = malloc(sizeof(*below->tris) * cm->tri_cnt * 2);
+        above->tris = malloc(sizeof(*above->tris) * cm->tri_cnt * 2);
+        for (uint32_t i = 0; i < cm->tri_cnt; ++i) {
+                const struct triangle *t;
+                float poly[2][4][3];
+                int poly_cnt[2];
+
+                t = cm->tris + i;
+                poly_cnt[0] = 0;
+                poly_cnt[1] = 0;
+
+                /* Lying in the plane, it bounds whichever side it faces */
+                if (t->p[0].v[axis] == pos && t->p[1].v[axis] == pos &&
+                    t->p[2].v[axis] == pos) {
+                        float ab[3], ac[3], n[3];
+
+                        vec3_sub(ab, t->p[1].v, t->p[0].v);
+                        vec3_sub(ac, t->p[2].v, t->p[0].v);
+                        vec3_cross(n, ab, ac);
+                        decompose_push_tri((n[axis] > 0.f) ? below : above,
+                                           t->p[0].v, t->p[1].v, t->p[2].v);
+                        continue;
+                }
+
+                for (int j = 0; j < 3; ++j) {
+                        const float *p, *q;
+                        float sp, sq;
+
+                        p = t->p[j].v;
+                        q = t->p[(j + 1) % 3].v;
+                        sp = p[axis] - pos;
+                        sq = q[axis] - pos;
+                        if (sp <= 0.f)
+                                memcpy(poly[0][poly_cnt[0]++], p,
+                                       sizeof(float) * 3);
+
+                        if (sp >= 0.f)
+                                memcpy(poly[1][poly_cnt[1]++], p,
+                                       sizeof(float) * 3);
+
+                        if ((sp < 0.f && sq > 0.f) ||
+                            (sp > 0.f && sq < 0.f)) {
+                                float x[3], f;
+
+                                f = sp / (sp - sq);
+                                for (int k = 0; k < 3; ++k)
+                                        x[k] = p[k] + (q[k] - p[k]) * f;
+
+                                x[axis] = pos;
+                                memcpy(poly[0][poly_cnt[0]++], x, sizeof(x));
+                                memcpy(poly[1][poly_cnt[1]++], x, sizeof(x));
+                        }
+                }
+
+                for (int j = 2; j < poly_cnt[0]; ++j)
+                        decompose_push_tri(below, poly[0][0], poly[0][j - 1],
+                                           poly[0][j]);
+
+                for (int j = 2; j < poly_cnt[1]; ++j)
+                        decompose_push_tri(above, poly[1][0], poly[1][j - 1],
+                                           poly[1][j]);
+        }
+}
+
+/*
+ * Deepest any surface point (corners and centroids) sits inside the
+ * part's hull. Zero for a convex part, rounding included, and `vol` gets
+ * the hull's volume.
+ */
+static float decompose_get_concavity(const struct collision_mesh *cm,
+                                     float *vol)
+{
+        struct hull h;
+        float depth;
+
+        *vol = 0.f;
+        if (!hull_build(&h, cm->tris[0].p, cm->tri_cnt * 3))
+                return 0.f;
+
+        *vol = hull_volume(&h);
+        depth = 0.f;
+        for (uint32_t i = 0; i < cm->tri_cnt; ++i) {
+                const struct triangle *t;
+                float c[3];
+
+                t = cm->tris + i;
+                for (int k = 0; k < 3; ++k) {
+                        c[k] = (t->p[0].v[k] + t->p[1].v[k] +
+                                t->p[2].v[k]) / 3.f;
+                        depth = fmaxf(depth, hull_get_depth(&h, t->p[k].v));
+                }
+
+                depth = fmaxf(depth, hull_get_depth(&h, c));
+        }
+
+        if (depth <= h.eps)
+                depth = 0.f;
+
+        hull_free(&h);
+
+        return depth;
+}
+
+/*
+ * Nearest vertex coordinate to `pos` strictly inside the part's extent,
+ * so cuts land on the creases modelled into the mesh.
+ */
+static float decompose_snap(const struct collision_mesh *cm, const int axis,
+                            const float pos, const float min, const float max)
+{
+        float best, best_dist;
+
+        best = pos;
+        best_dist = FLT_MAX;
+        for (uint32_t i = 0; i < cm->tri_cnt; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                        float v;
+
+                        v = cm->tris[i].p[j].v[axis];
+                        if (v <= min || v >= max ||
+                            fabsf(v - pos) >= best_dist)
+                                continue;
+
+                        best = v;
+                        best_dist = fabsf(v - pos);
+                }
+        }
+
+        return best;
+}
+
+/*
+ * Tries evenly spaced axis aligned planes through the part, each snapped
+ * to the nearest vertex, and keeps the one whose two halves have the least
+ * hull volume between them, which is the cut that takes away the most
+ * empty space. False if nothing splits.
+ */
+static bool decompose_split(struct collision_mesh *below,
+                            struct collision_mesh *above,
+                            const struct collision_mesh *cm)
+{
+        float mins[3], maxs[3], best_vol;
+        int best_axis;
+        float best_pos;
+
+        for (int k = 0; k < 3; ++k) {
+                mins[k] = FLT_MAX;
+                maxs[k] = -FLT_MAX;
+        }
+
+        for (uint32_t i = 0; i < cm->tri_cnt; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                        for (int k = 0; k < 3; ++k) {
+                                mins[k] = fminf(mins[k],
+                                                cm->tris[i].p[j].v[k]);
+                                maxs[k] = fmaxf(maxs[k],
+                                                cm->tris[i].p[j].v[k]);
+                        }
+                }
+        }
+
+        best_vol = FLT_MAX;
+        best_axis = -1;
+        best_pos = 0.f;
+        for (int axis = 0; axis < 3; ++axis) {
+                for (int i = 1; i <= DECOMPOSE_CUT_CNT; ++i) {
+                        float pos, vol_b, vol_a;
+
+                        pos = mins[axis] + (maxs[axis] - mins[axis]) * i /
+                              (DECOMPOSE_CUT_CNT + 1);
+                        pos = decompose_snap(cm, axis, pos, mins[axis],
+                                             maxs[axis]);
+                        decompose_cut(below, above, cm, axis, pos);
+                        if (below->tri_cnt && above->tri_cnt) {
+                                decompose_get_concavity(below, &vol_b);
+                                decompose_get_concavity(above, &vol_a);
+                                if (vol_b + vol_a < best_vol) {
+                                        best_vol = vol_b + vol_a;
+                                        best_axis = axis;
+                                        best_pos = pos;
+                                }
+                        }
+
+                        collision_mesh_free(below);
+                        collision_mesh_free(above);
+                }
+        }
+
+        if (best_axis < 0)
+                return false;
+
+        decompose_cut(below, above, cm, best_axis, best_pos);
+
+        return true;
+}
+
+/*
+ * The part's hull as triangles, or the part itself if it's flat, where its
+ * triangles are all the hull there is. Takes ownership of `part`, false if
+ * a part with volume still has no hull.
+ */
+static bool decompose_emit(struct collision_mesh *out,
+                           struct collision_mesh *part)
+{
+        struct hull h;
+        uint32_t first;
+
+        first = out->tri_cnt;
+        if (!hull_build(&h, part->tris[0].p, part->tri_cnt * 3)) {
+                if (!h.flat) {
+                        collision_mesh_free(part);
+                        return false;
+                }
+
+                collision_mesh_append(out, part);
+                collision_mesh_push_piece(out, first, out->tri_cnt - first,
+                                          COLLISION_PIECE_CONVEX);
+                return true;
+        }
+
+        out->tris = realloc(out->tris, sizeof(*out->tris) *
+                            (out->tri_cnt + h.face_cnt));
+        for (int i = 0; i < h.face_cnt; ++i)
+                decompose_push_tri(out, h.pts[h.faces[i].v[0]].v,
+                                   h.pts[h.faces[i].v[1]].v,
+                                   h.pts[h.faces[i].v[2]].v);
+
+        collision_mesh_push_piece(out, first, out->tri_cnt - first,
+                                  COLLISION_PIECE_CONVEX);
+        hull_free(&h);
+        collision_mesh_free(part);
+
+        return true;
+}
+
+/*
+ * Hierarchical approximate convex decomposition of one piece: keep
+ * splitting whichever part is least convex until every part is within
+ * `concavity` (a fraction of the piece's size) or there are `hull_max`
+ * parts, then emit each part as its hull. False if a part had none.
+ */
+static bool decompose_piece(struct collision_mesh *out,
+                            const struct collision_mesh *piece,
+                            const struct convert_opts *opts)
+{
+        struct decompose_part *parts;
+        float mins[3], maxs[3], diag[3], limit, vol;
+        int part_cnt;
+        bool ok;
+
+        for (int k = 0; k < 3; ++k) {
+                mins[k] = FLT_MAX;
+                maxs[k] = -FLT_MAX;
+        }
+
+        for (uint32_t i = 0; i < piece->tri_cnt; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                        for (int k = 0; k < 3; ++k) {
+                                mins[k] = fminf(mins[k],
+                                                piece->tris[i].p[j].v[k]);
+                                maxs[k] = fmaxf(maxs[k],
+                                                piece->tris[i].p[j].v[k]);
+                        }
+                }
+        }
+
+        vec3_sub(diag, maxs, mins);
+        limit = opts->concavity * vec3_len(diag);
+
+        parts = malloc(sizeof(*parts) * opts->hull_max);
+        collision_mesh_init(&parts[0].cm);
+        parts[0].cm.tri_cnt = piece->tri_cnt;
+        parts[0].cm.tris = malloc(sizeof(*piece->tris) * piece->tri_cnt);
+        memcpy(parts[0].cm.tris, piece->tris,
+               sizeof(*piece->tris) * piece->tri_cnt);
+        parts[0].concavity = decompose_get_concavity(&parts[0].cm, &vol);
+        part_cnt = 1;
+        while (part_cnt < opts->hull_max) {
+                struct collision_mesh below, above;
+                int worst;
+
+                worst = 0;
+                for (int i = 1; i < part_cnt; ++i)
+                        if (parts[i].concavity > parts[worst].concavity)
+                                worst = i;
+
+                if (parts[worst].concavity <= limit)
+                        break;
+
+                if (!decompose_split(&below, &above, &parts[worst].cm)) {
+                        parts[worst].concavity = -1.f;
+                        continue;
+                }
+
+                collision_mesh_free(&parts[worst].cm);
+                parts[worst].cm = below;
+                parts[worst].concavity = decompose_get_concavity(&below, &vol);
+                parts[part_cnt].cm = above;
+                parts[part_cnt].concavity = decompose_get_concavity(&above,
+                                                                    &vol);
+                ++part_cnt;
+        }
+
+        ok = true;
+        for (int i = 0; i < part_cnt; ++i)
+                ok &= decompose_emit(out, &parts[i].cm);
+
+        free(parts);
+
+        return ok;
+}
+
+/*
+ * Replaces every convex piece with one or more hulls, leaving the static
+ * mesh as it is. False if some part of a piece had no hull, which would
+ * otherwise go out concave and flagged convex.
+ */
+static bool collision_mesh_decompose(struct collision_mesh *cm,
+                                     const struct convert_opts *opts)
+{
+        struct collision_mesh out;
+        bool ok;
+
+        if (!cm->piece_cnt)
+                return true;
+
+        ok = true;
+        collision_mesh_init(&out);
+        for (uint32_t i = 0; i < cm->piece_cnt; ++i) {
+                const struct collision_piece *p;
+                struct collision_mesh piece;
+
+                p = cm->pieces + i;
+                piece.tri_cnt = p->cnt;
+                piece.tris = cm->tris + p->first;
+                if (p->flags & COLLISION_PIECE_CONVEX) {
+                        ok &= decompose_piece(&out, &piece, opts);
+                        continue;
+                }
+
+                out.tris = realloc(out.tris, sizeof(*out.tris) *
+                                   (out.tri_cnt + p->cnt));
+                memcpy(out.tris + out.tri_cnt, piece.tris,
+                       sizeof(*piece.tris) * p->cnt);
+                collision_mesh_push_piece(&out, out.tri_cnt, p->cnt,
+                                          p->flags);
+                out.tri_cnt += p->cnt;
+        }
+
+        collision_mesh_free(cm);
+        *cm = out;
+
+        return ok;
+}
+
+#endif /* DECOMPOSE_C */
@@ -0,0 +1,295 @@
+#ifndef HULL_C
+#define HULL_C
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+
+#define HULL_EPS_REL 1e-5f /* Of the point cloud's bounding diagonal */
+
+struct hull_face {
+        int v[3];
+        float n[3]; /* Outward, unit length */
+        float d;
+};
+
+/* Convex hull of a point cloud, faces index into `pts`. */
+struct hull {
+        const struct point *pts;
+        struct point centre; /* Strictly inside, to tell outwards apart */
+        float eps;
+        bool flat; /* No volume, why a build failed unless numerics did */
+        int face_cnt;
+        int face_cap;
+        struct hull_face *faces;
+};
+
+static void vec3_sub(float *out, const float *a, const float *b)
+{
+        for (int i = 0; i < 3; ++i)
+                out[i] = a[i] - b[i];
+}
+
+static float vec3_dot(const float *a, const float *b)
+{
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void vec3_cross(float *out, const float *a, const float *b)
+{
+        float tmp[3];
+
+        tmp[0] = a[1] * b[2] - a[2] * b[1];
+        tmp[1] = a[2] * b[0] - a[0] * b[2];
+        tmp[2] = a[0] * b[1] - a[1] * b[0];
+        memcpy(out, tmp, sizeof(tmp));
+}
+
+static float vec3_len(const float *a)
+{
+        return sqrtf(vec3_dot(a, a));
+}
+
+static bool hull_face_add(struct hull *h, const int a, const int b,
+                          const int c)
+{
+        struct hull_face *f;
+        float ab[3], ac[3], to_face[3], len;
+
+        if (h->face_cnt >= h->face_cap) {
+                h->face_cap = (h->face_cap) ? h->face_cap * 2 : 64;
+                h->faces = realloc(h->faces,
+                                   sizeof(*h->faces) * h->face_cap);
+        }
+
+        f = h->faces + h->face_cnt;
+        vec3_sub(ab, h->pts[b].v, h->pts[a].v);
+        vec3_sub(ac, h->pts[c].v, h->pts[a].v);
+        vec3_cross(f->n, ab, ac);
+        len = vec3_len(f->n);
+        if (len <= h->eps * h->eps)
+                return false;
+
+        for (int i = 0; i < 3; ++i)
+                f->n[i] /= len;
+
+        f->v[0] = a;
+        f->v[1] = b;
+        f->v[2] = c;
+
+        /* Keep the winding facing away from the inside */
+        vec3_sub(to_face, h->pts[a].v, h->centre.v);
+        if (vec3_dot(f->n, to_face) < 0.f) {
+                f->v[1] = c;
+                f->v[2] = b;
+                for (int i = 0; i < 3; ++i)
+                        f->n[i] = -f->n[i];
+        }
+
+        f->d = vec3_dot(f->n, h->pts[a].v);
+        ++h->face_cnt;
+
+        return true;
+}
+
+static void hull_edge_toggle(int (*edges)[2], int *edge_cnt,
+                             const int a, const int b)
+{
+        /* Shared with another visible face, so not on the horizon */
+        for (int i = 0; i < *edge_cnt; ++i) {
+                if (edges[i][0] == b && edges[i][1] == a) {
+                        edges[i][0] = edges[*edge_cnt - 1][0];
+                        edges[i][1] = edges[*edge_cnt - 1][1];
+                        --(*edge_cnt);
+                        return;
+                }
+        }
+
+        edges[*edge_cnt][0] = a;
+        edges[*edge_cnt][1] = b;
+        ++(*edge_cnt);
+}
+
+static int hull_farthest(const struct point *pts, const int cnt,
+                         const float *origin, const float *dir,
+                         const int mode, float *best_out)
+{
+        float best;
+        int best_ind;
+
+        best = -1.f;
+        best_ind = 0;
+        for (int i = 0; i < cnt; ++i) {
+                float off[3], cr[3], dist;
+
+                vec3_sub(off, pts[i].v, origin);
+                if (mode == 0) {
+                        dist = vec3_len(off);
+                } else if (mode == 1) {
+                        vec3_cross(cr, off, dir);
+                        dist = vec3_len(cr);
+                } else {
+                        dist = fabsf(vec3_dot(off, dir));
+                }
+
+                if (dist > best) {
+                        best = dist;
+                        best_ind = i;
+                }
+        }
+
+        *best_out = best;
+
+        return best_ind;
+}
+
+static void hull_free(struct hull *h)
+{
+        free(h->faces);
+        h->faces = NULL;
+        h->face_cnt = 0;
+        h->face_cap = 0;
+}
+
+/*
+ * Incremental hull: start from the widest tetrahedron, then for every
+ * point outside, carve out the faces it can see and fan new ones from the
+ * horizon to it. Flat or empty clouds have no hull and return false with
+ * `flat` set.
+ */
+static bool hull_build(struct hull *h, const struct point *pts, const int cnt)
+{
+        static const int tetra[4][3] = {
+                {0, 1, 2}, {0, 3, 1}, {0, 2, 3}, {1, 3, 2}
+        };
+        float mins[3], maxs[3], diag[3], line[3], n[3], a[3], b[3], dist;
+        int (*edges)[2];
+        int init[4];
+        bool ok;
+
+        h->pts = pts;
+        h->face_cnt = 0;
+        h->face_cap = 0;
+        h->faces = NULL;
+        h->flat = true;
+        if (cnt < 4)
+                return false;
+
+        for (int k = 0; k < 3; ++k) {
+                mins[k] = FLT_MAX;
+                maxs[k] = -FLT_MAX;
+        }
+
+        init[0] = 0;
+        for (int i = 0; i < cnt; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                        mins[k] = fminf(mins[k], pts[i].v[k]);
+                        maxs[k] = fmaxf(maxs[k], pts[i].v[k]);
+                }
+
+                if (pts[i].v[0] < pts[init[0]].v[0])
+                        init[0] = i;
+        }
+
+        vec3_sub(diag, maxs, mins);
+        h->eps = fmaxf(HULL_EPS_REL * vec3_len(diag), FLT_MIN);
+
+        /* Widest tetrahedron from extreme points */
+        init[1] = hull_farthest(pts, cnt, pts[init[0]].v, NULL, 0, &dist);
+        if (dist <= h->eps)
+                return false;
+
+        vec3_sub(line, pts[init[1]].v, pts[init[0]].v);
+        for (int k = 0; k < 3; ++k)
+                line[k] /= dist;
+
+        init[2] = hull_farthest(pts, cnt, pts[init[0]].v, line, 1, &dist);
+        if (dist <= h->eps)
+                return false;
+
+        vec3_sub(a, pts[init[1]].v, pts[init[0]].v);
+        vec3_sub(b, pts[init[2]].v, pts[init[0]].v);
+        vec3_cross(n, a, b);
+        dist = vec3_len(n);
+        for (int k = 0; k < 3; ++k)
+                n[k] /= dist;
+
+        init[3] = hull_farthest(pts, cnt, pts[init[0]].v, n, 2, &dist);
+        if (dist <= h->eps)
+                return false;
+
+        h->flat = false;
+
+        for (int k = 0; k < 3; ++k)
+                h->centre.v[k] = (pts[init[0]].v[k] + pts[init[1]].v[k] +
+                                  pts[init[2]].v[k] + pts[init[3]].v[k]) / 4.f;
+
+        ok = true;
+        for (int i = 0; i < 4 && ok; ++i)
+                ok = hull_face_add(h, init[tetra[i][0]], init[tetra[i][1]],
+                                   init[tetra[i][2]]);
+
+        edges = NULL;
+        for (int p = 0; p < cnt && ok; ++p) {
+                int edge_cnt;
+
+                edges = realloc(edges, sizeof(*edges) * h->face_cnt * 3);
+                edge_cnt = 0;
+                for (int i = h->face_cnt - 1; i >= 0; --i) {
+                        struct hull_face *f;
+
+                        f = h->faces + i;
+                        if (vec3_dot(f->n, pts[p].v) - f->d <= h->eps)
+                                continue;
+
+                        hull_edge_toggle(edges, &edge_cnt, f->v[0], f->v[1]);
+                        hull_edge_toggle(edges, &edge_cnt, f->v[1], f->v[2]);
+                        hull_edge_toggle(edges, &edge_cnt, f->v[2], f->v[0]);
+                        *f = h->faces[--h->face_cnt];
+                }
+
+                for (int i = 0; i < edge_cnt && ok; ++i)
+                        ok = hull_face_add(h, edges[i][0], edges[i][1], p);
+        }
+
+        free(edges);
+        if (!ok)
+                hull_free(h);
+
+        return ok;
+}
+
+static float hull_volume(const struct hull *h)
+{
+        float vol;
+
+        vol = 0.f;
+        for (int i = 0; i < h->face_cnt; ++i) {
+                const struct hull_face *f;
+                float a[3], b[3], c[3], cr[3];
+
+                f = h->faces + i;
+                vec3_sub(a, h->pts[f->v[0]].v, h->centre.v);
+                vec3_sub(b, h->pts[f->v[1]].v, h->centre.v);
+                vec3_sub(c, h->pts[f->v[2]].v, h->centre.v);
+                vec3_cross(cr, b, c);
+                vol += vec3_dot(a, cr) / 6.f;
+        }
+
+        return vol;
+}
+
+/* How far inside the hull `p` is, zero on or outside it. */
+static float hull_get_depth(const struct hull *h, const float *p)
+{
+        float depth;
+
+        depth = FLT_MAX;
+        for (int i = 0; i < h->face_cnt; ++i)
+                depth = fminf(depth, h->faces[i].d -
+                              vec3_dot(h->faces[i].n, p));
+
+        return fmaxf(depth, 0.f);
+}
+
+#endif /* HULL_C */
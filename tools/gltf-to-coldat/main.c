@@ -1,10 +1,19 @@
 /* #define DO_DEBUG_PRINT */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
 #define CGLTF_IMPLEMENTATION
 #include "cgltf.h"
 #include "structs.c"
 #include "collision_mesh.c"
+#include "decompose.c"
+#include "simplify.c"
 #include "util.c"
+#include "cache.c"
 
 enum {
         RET_GOOD,
@@ -13,70 +22,310 @@ enum {
         RET_BIN_LOAD_FAIL,
         RET_CGLTF_FAIL,
         RET_COLMESH_FILE_READ_FAIL,
+        RET_MANIFEST_LOAD_FAIL,
+        RET_THREAD_FAIL,
+        RET_DECOMPOSE_FAIL,
         RET_CODE_CNT
 };
 
-int main(const int argc, const char **argv)
+#define THREAD_MAX 64
+#define CONCAVITY_DEFAULT .02f
+#define HULL_MAX_DEFAULT 16
+#define WELD_DEFAULT 1e-4f
+
+/* Converts `in_dir/obj_name.gltf` (or `.glb`) into `out_dir/obj_name.cm`. */
+static int object_convert(const struct convert_job *job,
+                          const char *obj_name, struct convert_result *res)
 {
-        const char *obj_name = NULL, *out_path = NULL, *in_path = NULL;
-        char *gltf_path = NULL, *bin_path = NULL,
-             *gltf_buf = NULL, *bin_buf = NULL,
-             *cm_path = NULL;
-        size_t gltf_buf_sz = 0, bin_buf_sz = 0;
+        char *gltf_path = NULL, *cm_path = NULL;
         cgltf_options gltf_opt = { 0 };
         cgltf_data *gltf_data = NULL;
         cgltf_result gltf_res = { 0 };
+        struct file_map_list maps = { 0 };
         struct collision_mesh cm;
+        uint64_t hash;
+        int ret;
 
-        if (argc < 3) {
-                printf("usage: %s in_dir out_dir obj_name\n", argv[0]);
-                return RET_FILE_NAME_NOT_SUPPLIED;
-        }
-
-        /* Aquire file data */
-        in_path = argv[1];
-        out_path = argv[2];
-        obj_name = argv[3];
-        gltf_get_paths_from_name(&gltf_path, &bin_path,
-                                 &cm_path, in_path, out_path, obj_name);
-        if (!(gltf_buf = file_get_buffer(gltf_path, &gltf_buf_sz)))
-                return RET_GLTF_LOAD_FAIL;
+        ret = RET_GOOD;
+        collision_mesh_init(&cm);
+        gltf_get_paths_from_name(&gltf_path, &cm_path, job->in_path,
+                                 job->out_path, obj_name);
 
-        if (!(bin_buf = file_get_buffer(bin_path, &bin_buf_sz)))
-                return RET_BIN_LOAD_FAIL;
-
-        /* Rip that shit! */
+        /* Rip that shit! Inputs are mapped, not read */
+        gltf_opt.file.read = file_map_read;
+        gltf_opt.file.release = file_map_release;
+        gltf_opt.file.user_data = &maps;
         gltf_res = cgltf_parse_file(&gltf_opt, gltf_path, &gltf_data);
         if (gltf_res != cgltf_result_success) {
                 printf("CGLTF failed to parse file '%s'.\n", gltf_path);
-                return RET_CGLTF_FAIL;
+                ret = (gltf_res == cgltf_result_file_not_found) ?
+                      RET_GLTF_LOAD_FAIL : RET_CGLTF_FAIL;
+                goto out;
         }
 
-        cm.tri_cnt = 0;
-        cm.tris = NULL;
+        /* Whatever buffers it names: .bin files, data URIs or GLB chunk */
+        gltf_res = cgltf_load_buffers(&gltf_opt, gltf_data, gltf_path);
+        if (gltf_res != cgltf_result_success) {
+                printf("CGLTF failed to load buffers for '%s'.\n",
+                       gltf_path);
+                ret = RET_BIN_LOAD_FAIL;
+                goto out;
+        }
+
+        gltf_data_to_collision_mesh(&cm, gltf_data, gltf_path);
+        res->src_tri_cnt = cm.tri_cnt;
+        res->src_vert_cnt = collision_mesh_get_vert_cnt(&cm);
+
+        /* Same geometry as last time, leave the output alone */
+        hash = cache_hash_mesh(&cm, &job->opts);
+        if ((res->cached = cache_check(cm_path, hash))) {
+                /* Report what's in the output, not what went in */
+                collision_mesh_free(&cm);
+                if (!collision_mesh_read_from_file(&cm, cm_path)) {
+                        printf("Failed to read from collision file '%s'.\n",
+                               cm_path);
+                        ret = RET_COLMESH_FILE_READ_FAIL;
+                        goto out;
+                }
+
+                res->tri_cnt = cm.tri_cnt;
+                res->vert_cnt = collision_mesh_get_vert_cnt(&cm);
+                res->piece_cnt = cm.piece_cnt;
+                goto out;
+        }
 
-        gltf_data_to_collision_mesh(&cm, gltf_data, bin_buf);
+        collision_mesh_simplify(&cm, &job->opts);
+        if (!collision_mesh_decompose(&cm, &job->opts)) {
+                printf("Failed to find the hull of a `col_*` piece in '%s'.\n",
+                       gltf_path);
+                ret = RET_DECOMPOSE_FAIL;
+                goto out;
+        }
         if (!collision_mesh_write_to_file(&cm, cm_path)) {
                 printf("Failed to write to collision file '%s'.\n", cm_path);
-                return RET_COLMESH_FILE_READ_FAIL;
+                ret = RET_COLMESH_FILE_READ_FAIL;
+                goto out;
         }
 
         collision_mesh_free(&cm);
         if (!collision_mesh_read_from_file(&cm, cm_path)) {
                 printf("Failed to read from collision file '%s'.\n", cm_path);
-                return RET_COLMESH_FILE_READ_FAIL;
+                ret = RET_COLMESH_FILE_READ_FAIL;
+                goto out;
         }
 
         collision_mesh_printf(&cm);
+        res->tri_cnt = cm.tri_cnt;
+        res->vert_cnt = collision_mesh_get_vert_cnt(&cm);
+        res->piece_cnt = cm.piece_cnt;
+        if (!cache_write(cm_path, hash))
+                printf("Failed to write cache for '%s'.\n", cm_path);
 
         /* Nuke it all */
+out:
         collision_mesh_free(&cm);
         cgltf_free(gltf_data);
+        file_map_list_free(&maps);
         free(cm_path);
-        free(bin_buf);
-        free(gltf_buf);
-        free(bin_path);
         free(gltf_path);
 
-        return RET_GOOD;
+        return ret;
+}
+
+static double time_get_ms(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * Threads pull the next unclaimed object until there are none left. Each
+ * object only ever writes its own output file and result slot, so what
+ * ends up on disk doesn't depend on which thread ran it or when.
+ */
+static void *convert_worker(void *arg)
+{
+        struct convert_job *job;
+
+        job = arg;
+        for (;;) {
+                struct convert_result *res;
+                double start;
+                int i;
+
+                pthread_mutex_lock(&job->lock);
+                i = job->next++;
+                pthread_mutex_unlock(&job->lock);
+                if (i >= job->names->cnt)
+                        break;
+
+                res = job->results + i;
+                res->src_tri_cnt = 0;
+                res->src_vert_cnt = 0;
+                res->tri_cnt = 0;
+                res->vert_cnt = 0;
+                res->piece_cnt = 0;
+                res->cached = false;
+                start = time_get_ms();
+                res->ret = object_convert(job, job->names->names[i], res);
+                res->ms = time_get_ms() - start;
+        }
+
+        return NULL;
+}
+
+static int convert_all(struct convert_job *job, int thread_cnt)
+{
+        pthread_t threads[THREAD_MAX];
+        int started;
+
+        if (thread_cnt > job->names->cnt)
+                thread_cnt = job->names->cnt;
+
+        /* The calling thread works too, so one thread spawns nothing */
+        started = 0;
+        for (int i = 1; i < thread_cnt; ++i) {
+                if (pthread_create(threads + i, NULL, convert_worker, job))
+                        break;
+
+                ++started;
+        }
+
+        convert_worker(job);
+        for (int i = 1; i <= started; ++i)
+                pthread_join(threads[i], NULL);
+
+        return started + 1;
+}
+
+static int thread_cnt_default(void)
+{
+        long cnt;
+
+        cnt = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cnt < 1)
+                return 1;
+
+        return (cnt > THREAD_MAX) ? THREAD_MAX : cnt;
+}
+
+int main(const int argc, const char **argv)
+{
+        const char *out_path = NULL, *in_path = NULL;
+        struct convert_job job;
+        struct name_list names;
+        int ret, arg, thread_cnt;
+        double start;
+
+        /* Threads default to one per core */
+        thread_cnt = thread_cnt_default();
+        job.opts.concavity = CONCAVITY_DEFAULT;
+        job.opts.hull_max = HULL_MAX_DEFAULT;
+        job.opts.weld = WELD_DEFAULT;
+        job.opts.tri_max = 0;
+        job.opts.vert_max = 0;
+        for (arg = 1; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+                if (!strcmp(argv[arg], "-j")) {
+                        thread_cnt = atoi(argv[arg + 1]);
+                        if (thread_cnt < 1)
+                                thread_cnt = 1;
+
+                        if (thread_cnt > THREAD_MAX)
+                                thread_cnt = THREAD_MAX;
+                } else if (!strcmp(argv[arg], "-c")) {
+                        job.opts.concavity = fmaxf(atof(argv[arg + 1]), 0.f);
+                } else if (!strcmp(argv[arg], "-n")) {
+                        job.opts.hull_max = atoi(argv[arg + 1]);
+                        if (job.opts.hull_max < 1)
+                                job.opts.hull_max = 1;
+                } else if (!strcmp(argv[arg], "-w")) {
+                        job.opts.weld = fmaxf(atof(argv[arg + 1]), 0.f);
+                } else if (!strcmp(argv[arg], "-t")) {
+                        job.opts.tri_max = strtoul(argv[arg + 1], NULL, 10);
+                } else if (!strcmp(argv[arg], "-v")) {
+                        job.opts.vert_max = strtoul(argv[arg + 1], NULL, 10);
+                } else {
+                        break;
+                }
+        }
+
+        if (argc - arg < 3) {
+                printf("usage: %s [-j threads] [-c concavity] [-n hull_max] "
+                       "[-w weld] [-t tri_max] [-v vert_max] "
+                       "in_dir out_dir obj_name|@manifest...\n", argv[0]);
+                printf("  -c  allowed concavity of `col_*` pieces, as a "
+                       "fraction of their size (%g)\n", CONCAVITY_DEFAULT);
+                printf("  -n  most hulls to split each piece into (%d)\n",
+                       HULL_MAX_DEFAULT);
+                printf("  -w  distance under which corners merge (%g)\n",
+                       WELD_DEFAULT);
+                printf("  -t  triangle budget for the static mesh, 0 for "
+                       "none (0)\n");
+                printf("  -v  vertex budget for the static mesh, 0 for "
+                       "none (0)\n");
+                return RET_FILE_NAME_NOT_SUPPLIED;
+        }
+
+        /* Gather every object up front, then convert them in one go */
+        in_path = argv[arg];
+        out_path = argv[arg + 1];
+        name_list_init(&names);
+        for (int i = arg + 2; i < argc; ++i) {
+                if (argv[i][0] != '@') {
+                        name_list_push(&names, argv[i]);
+                        continue;
+                }
+
+                if (!name_list_push_manifest(&names, argv[i] + 1)) {
+                        name_list_free(&names);
+                        return RET_MANIFEST_LOAD_FAIL;
+                }
+        }
+
+        job.in_path = in_path;
+        job.out_path = out_path;
+        job.names = &names;
+        job.results = calloc(names.cnt, sizeof(*job.results));
+        job.next = 0;
+        if (pthread_mutex_init(&job.lock, NULL)) {
+                free(job.results);
+                name_list_free(&names);
+                return RET_THREAD_FAIL;
+        }
+
+        start = time_get_ms();
+        thread_cnt = convert_all(&job, thread_cnt);
+
+        /* Reported in the order given, whatever order they finished in */
+        ret = RET_GOOD;
+        for (int i = 0; i < names.cnt; ++i) {
+                const struct convert_result *res;
+
+                res = job.results + i;
+                if (res->ret != RET_GOOD) {
+                        printf("Failed to convert '%s'.\n", names.names[i]);
+                        if (ret == RET_GOOD)
+                                ret = res->ret;
+
+                        continue;
+                }
+
+                printf("%8.2f ms %8u -> %8u tris %8u -> %8u verts "
+                       "%4u pieces  %s%s\n", res->ms, res->src_tri_cnt,
+                       res->tri_cnt, res->src_vert_cnt, res->vert_cnt,
+                       res->piece_cnt, names.names[i],
+                       (res->cached) ? " (cached)" : "");
+        }
+
+        printf("%8.2f ms total, %d objects on %d threads\n",
+               time_get_ms() - start, names.cnt, thread_cnt);
+
+        pthread_mutex_destroy(&job.lock);
+        free(job.results);
+        name_list_free(&names);
+
+        return ret;
 }
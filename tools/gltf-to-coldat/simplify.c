@@ -0,0 +1,732 @@
+#ifndef SIMPLIFY_C
+#define SIMPLIFY_C
+
+#include "hull.c"
+
+#define SIMPLIFY_AREA_EPS 1e-12f /* Squared, below which a tri is a line */
+#define SIMPLIFY_BORDER_WEIGHT 1000.0 /* Keeps open edges where they are */
+#define SIMPLIFY_FLIP_DOT .2f /* Least a moved tri's normal may turn by */
+
+/* Indexed triangles, so vertices can be merged and moved. */
+struct simplify_mesh {
+        uint32_t vert_cnt;
+        struct point *verts;
+        uint32_t tri_cnt;
+        uint32_t (*tris)[3];
+};
+
+/* Error quadric, the upper triangle of a symmetric 4x4 matrix. */
+struct simplify_quadric {
+        double q[10];
+};
+
+struct simplify_edge {
+        double cost;
+        uint32_t u;
+        uint32_t v;
+        uint32_t stamp_u; /* Stale once either end has moved since */
+        uint32_t stamp_v;
+        float pos[3]; /* Where the two end up */
+};
+
+struct simplify_list {
+        uint32_t *v;
+        uint32_t cnt;
+        uint32_t cap;
+};
+
+static void simplify_mesh_free(struct simplify_mesh *sm)
+{
+        free(sm->verts);
+        free(sm->tris);
+        sm->vert_cnt = 0;
+        sm->verts = NULL;
+        sm->tri_cnt = 0;
+        sm->tris = NULL;
+}
+
+static void simplify_list_push(struct simplify_list *l, const uint32_t v)
+{
+        if (l->cnt >= l->cap) {
+                l->cap = (l->cap) ? l->cap * 2 : 8;
+                l->v = realloc(l->v, sizeof(*l->v) * l->cap);
+        }
+
+        l->v[l->cnt++] = v;
+}
+
+static uint32_t simplify_cell_hash(const int64_t *c, const uint32_t mask)
+{
+        return (uint32_t)(((uint64_t)c[0] * 73856093u) ^
+                          ((uint64_t)c[1] * 19349663u) ^
+                          ((uint64_t)c[2] * 83492791u)) & mask;
+}
+
+/* Cells `eps` wide, or the exact bits of `p` when `eps` is zero. */
+static void simplify_cell_get(int64_t *c, const float *p, const float eps)
+{
+        for (int k = 0; k < 3; ++k) {
+                if (eps > 0.f) {
+                        c[k] = (int64_t)floor((double)p[k] / eps);
+                } else {
+                        float f;
+                        int32_t bits;
+
+                        f = p[k] + 0.f; /* -0 and 0 are the same place */
+                        memcpy(&bits, &f, sizeof(bits));
+                        c[k] = bits;
+                }
+        }
+}
+
+/*
+ * Indexes `tris`, merging every corner within `eps` of a vertex already
+ * seen into it. A spatial hash on `eps` sized cells means only the 27
+ * around each corner are searched.
+ */
+static void simplify_weld(struct simplify_mesh *sm,
+                          const struct triangle *tris, const uint32_t tri_cnt,
+                          const float eps)
+{
+        uint32_t mask, *heads, *next;
+        int64_t (*cells)[3];
+        int reach;
+
+        mask = 1;
+        while (mask < tri_cnt * 6)
+                mask <<= 1;
+
+        heads = malloc(sizeof(*heads) * mask);
+        memset(heads, 0xFF, sizeof(*heads) * mask);
+        --mask;
+        next = malloc(sizeof(*next) * tri_cnt * 3);
+        cells = malloc(sizeof(*cells) * tri_cnt * 3);
+        sm->verts = malloc(sizeof(*sm->verts) * tri_cnt * 3);
+        sm->tris = malloc(sizeof(*sm->tris) * tri_cnt);
+        sm->vert_cnt = 0;
+        sm->tri_cnt = tri_cnt;
+        reach = (eps > 0.f) ? 1 : 0;
+        for (uint32_t i = 0; i < tri_cnt * 3; ++i) {
+                const float *p;
+                int64_t c[3];
+                uint32_t found, h;
+
+                p = tris[i / 3].p[i % 3].v;
+                simplify_cell_get(c, p, eps);
+                found = UINT32_MAX;
+                for (int dx = -reach; dx <= reach; ++dx) {
+                        for (int dy = -reach; dy <= reach; ++dy) {
+                                for (int dz = -reach; dz <= reach; ++dz) {
+                                        int64_t n[3];
+
+                                        n[0] = c[0] + dx;
+                                        n[1] = c[1] + dy;
+                                        n[2] = c[2] + dz;
+                                        h = simplify_cell_hash(n, mask);
+                                        for (uint32_t j = heads[h];
+                                             j != UINT32_MAX &&
+                                             found == UINT32_MAX;
+                                             j = next[j]) {
+                                                float d[3];
+
+                                                if (memcmp(cells[j], n,
+                                                           sizeof(n)))
+                                                        continue;
+
+                                                vec3_sub(d, sm->verts[j].v, p);
+                                                if (vec3_dot(d, d) <=
+                                                    eps * eps)
+                                                        found = j;
+                                        }
+                                }
+                        }
+                }
+
+                if (found == UINT32_MAX) {
+                        found = sm->vert_cnt++;
+                        sm->verts[found] = tris[i / 3].p[i % 3];
+                        memcpy(cells[found], c, sizeof(c));
+                        h = simplify_cell_hash(c, mask);
+                        next[found] = heads[h];
+                        heads[h] = found;
+                }
+
+                sm->tris[i / 3][i % 3] = found;
+        }
+
+        free(cells);
+        free(next);
+        free(heads);
+}
+
+static void simplify_tri_get_normal(float *n, const struct point *verts,
+                                    const uint32_t *t)
+{
+        float ab[3], ac[3];
+
+        vec3_sub(ab, verts[t[1]].v, verts[t[0]].v);
+        vec3_sub(ac, verts[t[2]].v, verts[t[0]].v);
+        vec3_cross(n, ab, ac);
+}
+
+/* Drops triangles with a repeated corner or no area to speak of. */
+static void simplify_drop_degenerate(struct simplify_mesh *sm)
+{
+        uint32_t kept;
+
+        kept = 0;
+        for (uint32_t i = 0; i < sm->tri_cnt; ++i) {
+                const uint32_t *t;
+                float n[3];
+
+                t = sm->tris[i];
+                if (t[0] == t[1] || t[1] == t[2] || t[2] == t[0])
+                        continue;
+
+                simplify_tri_get_normal(n, sm->verts, t);
+                if (vec3_dot(n, n) <= SIMPLIFY_AREA_EPS)
+                        continue;
+
+                memmove(sm->tris[kept++], t, sizeof(*sm->tris));
+        }
+
+        sm->tri_cnt = kept;
+}
+
+/* Adds `w` times the squared distance to plane `n`.x + `d` = 0. */
+static void simplify_quadric_add_plane(struct simplify_quadric *qd,
+                                       const double *n, const double d,
+                                       const double w)
+{
+        double *q;
+
+        q = qd->q;
+        q[0] += w * n[0] * n[0];
+        q[1] += w * n[0] * n[1];
+        q[2] += w * n[0] * n[2];
+        q[3] += w * n[0] * d;
+        q[4] += w * n[1] * n[1];
+        q[5] += w * n[1] * n[2];
+        q[6] += w * n[1] * d;
+        q[7] += w * n[2] * n[2];
+        q[8] += w * n[2] * d;
+        q[9] += w * d * d;
+}
+
+static double simplify_quadric_eval(const struct simplify_quadric *qd,
+                                    const float *p)
+{
+        const double *q;
+        double x, y, z;
+
+        q = qd->q;
+        x = p[0];
+        y = p[1];
+        z = p[2];
+
+        return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z +
+               2.0 * q[3] * x + q[4] * y * y + 2.0 * q[5] * y * z +
+               2.0 * q[6] * y + q[7] * z * z + 2.0 * q[8] * z + q[9];
+}
+
+/*
+ * Where collapsing `u` and `v` costs the least: the quadric's minimum if
+ * it has one, else the better of the two ends and their midpoint.
+ */
+static void simplify_edge_make(struct simplify_edge *e,
+                               const struct simplify_mesh *sm,
+                               const struct simplify_quadric *quads,
+                               const uint32_t *stamps, const uint32_t u,
+                               const uint32_t v)
+{
+        struct simplify_quadric q;
+        const float *cand[3];
+        float mid[3];
+        double det;
+
+        for (int i = 0; i < 10; ++i)
+                q.q[i] = quads[u].q[i] + quads[v].q[i];
+
+        e->u = u;
+        e->v = v;
+        e->stamp_u = stamps[u];
+        e->stamp_v = stamps[v];
+
+        det = q.q[0] * (q.q[4] * q.q[7] - q.q[5] * q.q[5]) -
+              q.q[1] * (q.q[1] * q.q[7] - q.q[5] * q.q[2]) +
+              q.q[2] * (q.q[1] * q.q[5] - q.q[4] * q.q[2]);
+        if (fabs(det) > 1e-9) {
+                double b[3];
+
+                b[0] = -q.q[3];
+                b[1] = -q.q[6];
+                b[2] = -q.q[8];
+                e->pos[0] = (b[0] * (q.q[4] * q.q[7] - q.q[5] * q.q[5]) -
+                             q.q[1] * (b[1] * q.q[7] - q.q[5] * b[2]) +
+                             q.q[2] * (b[1] * q.q[5] - q.q[4] * b[2])) / det;
+                e->pos[1] = (q.q[0] * (b[1] * q.q[7] - b[2] * q.q[5]) -
+                             b[0] * (q.q[1] * q.q[7] - q.q[5] * q.q[2]) +
+                             q.q[2] * (q.q[1] * b[2] - b[1] * q.q[2])) / det;
+                e->pos[2] = (q.q[0] * (q.q[4] * b[2] - q.q[5] * b[1]) -
+                             q.q[1] * (q.q[1] * b[2] - b[1] * q.q[2]) +
+                             b[0] * (q.q[1] * q.q[5] - q.q[4] * q.q[2])) / det;
+                e->cost = simplify_quadric_eval(&q, e->pos);
+                return;
+        }
+
+        for (int k = 0; k < 3; ++k)
+                mid[k] = (sm->verts[u].v[k] + sm->verts[v].v[k]) * .5f;
+
+        cand[0] = sm->verts[u].v;
+        cand[1] = sm->verts[v].v;
+        cand[2] = mid;
+        e->cost = DBL_MAX;
+        for (int i = 0; i < 3; ++i) {
+                double cost;
+
+                cost = simplify_quadric_eval(&q, cand[i]);
+                if (cost < e->cost) {
+                        e->cost = cost;
+                        memcpy(e->pos, cand[i], sizeof(e->pos));
+                }
+        }
+}
+
+static void simplify_heap_push(struct simplify_edge **heap, uint32_t *cnt,
+                               uint32_t *cap, const struct simplify_edge *e)
+{
+        uint32_t i;
+
+        if (*cnt >= *cap) {
+                *cap = (*cap) ? *cap * 2 : 64;
+                *heap = realloc(*heap, sizeof(**heap) * *cap);
+        }
+
+        i = (*cnt)++;
+        while (i && (*heap)[(i - 1) / 2].cost > e->cost) {
+                (*heap)[i] = (*heap)[(i - 1) / 2];
+                i = (i - 1) / 2;
+        }
+
+        (*heap)[i] = *e;
+}
+
+static struct simplify_edge simplify_heap_pop(struct simplify_edge *heap,
+                                              uint32_t *cnt)
+{
+        struct simplify_edge top, last;
+        uint32_t i;
+
+        top = heap[0];
+        last = heap[--(*cnt)];
+        i = 0;
+        for (;;) {
+                uint32_t c;
+
+                c = i * 2 + 1;
+                if (c >= *cnt)
+                        break;
+
+                if (c + 1 < *cnt && heap[c + 1].cost < heap[c].cost)
+                        ++c;
+
+                if (heap[c].cost >= last.cost)
+                        break;
+
+                heap[i] = heap[c];
+                i = c;
+        }
+
+        if (*cnt)
+                heap[i] = last;
+
+        return top;
+}
+
+static int simplify_edge_cmp(const void *a, const void *b)
+{
+        const uint32_t *ea, *eb;
+
+        ea = a;
+        eb = b;
+        if (ea[0] != eb[0])
+                return (ea[0] < eb[0]) ? -1 : 1;
+
+        if (ea[1] != eb[1])
+                return (ea[1] < eb[1]) ? -1 : 1;
+
+        return 0;
+}
+
+/*
+ * Quadric per vertex from the planes of the triangles around it, area
+ * weighted, plus steep planes along any edge only one triangle uses so
+ * holes and the rims of open meshes don't drift.
+ */
+static void simplify_quadrics_init(struct simplify_quadric *quads,
+                                   const struct simplify_mesh *sm,
+                                   uint32_t (*edges)[3])
+{
+        for (uint32_t i = 0; i < sm->tri_cnt; ++i) {
+                const uint32_t *t;
+                float n[3];
+                double nd[3], len, d;
+
+                t = sm->tris[i];
+                simplify_tri_get_normal(n, sm->verts, t);
+                len = vec3_len(n);
+                for (int k = 0; k < 3; ++k)
+                        nd[k] = n[k] / len;
+
+                d = -(nd[0] * sm->verts[t[0]].v[0] +
+                      nd[1] * sm->verts[t[0]].v[1] +
+                      nd[2] * sm->verts[t[0]].v[2]);
+                for (int k = 0; k < 3; ++k) {
+                        uint32_t *e;
+
+                        simplify_quadric_add_plane(quads + t[k], nd, d,
+                                                   len * .5);
+                        e = edges[i * 3 + k];
+                        e[0] = t[k];
+                        e[1] = t[(k + 1) % 3];
+                        e[2] = i;
+                        if (e[0] > e[1]) {
+                                e[0] = t[(k + 1) % 3];
+                                e[1] = t[k];
+                        }
+                }
+        }
+
+        qsort(edges, sm->tri_cnt * 3, sizeof(*edges), simplify_edge_cmp);
+        for (uint32_t i = 0; i < sm->tri_cnt * 3; ++i) {
+                const uint32_t *e, *t;
+                float n[3], dir[3], side[3];
+                double nd[3], len, d;
+
+                e = edges[i];
+                if ((i && !simplify_edge_cmp(edges[i - 1], e)) ||
+                    (i + 1 < sm->tri_cnt * 3 &&
+                     !simplify_edge_cmp(edges[i + 1], e)))
+                        continue;
+
+                t = sm->tris[e[2]];
+                simplify_tri_get_normal(n, sm->verts, t);
+                vec3_sub(dir, sm->verts[e[1]].v, sm->verts[e[0]].v);
+                vec3_cross(side, dir, n);
+                len = vec3_len(side);
+                if (len <= 0.0)
+                        continue;
+
+                for (int k = 0; k < 3; ++k)
+                        nd[k] = side[k] / len;
+
+                d = -(nd[0] * sm->verts[e[0]].v[0] +
+                      nd[1] * sm->verts[e[0]].v[1] +
+                      nd[2] * sm->verts[e[0]].v[2]);
+                len = vec3_dot(dir, dir);
+                simplify_quadric_add_plane(quads + e[0], nd, d,
+                                           SIMPLIFY_BORDER_WEIGHT * len);
+                simplify_quadric_add_plane(quads + e[1], nd, d,
+                                           SIMPLIFY_BORDER_WEIGHT * len);
+        }
+}
+
+/*
+ * False if moving `u` and `v` to `pos` would turn any triangle around
+ * them over or squash it flat. Those that have both die anyway.
+ */
+static bool simplify_collapse_is_valid(const struct simplify_mesh *sm,
+                                       const struct simplify_list *adj,
+                                       const bool *tri_dead,
+                                       const uint32_t u, const uint32_t v,
+                                       const float *pos)
+{
+        const uint32_t ends[2] = { u, v };
+
+        for (int i = 0; i < 2; ++i) {
+                const struct simplify_list *l;
+
+                l = adj + ends[i];
+                for (uint32_t j = 0; j < l->cnt; ++j) {
+                        struct point moved[3];
+                        const uint32_t *t;
+                        const uint32_t ind[3] = { 0, 1, 2 };
+                        float n_old[3], n_new[3];
+                        bool has_u, has_v;
+
+                        if (tri_dead[l->v[j]])
+                                continue;
+
+                        t = sm->tris[l->v[j]];
+                        has_u = (t[0] == u || t[1] == u || t[2] == u);
+                        has_v = (t[0] == v || t[1] == v || t[2] == v);
+                        if (has_u && has_v)
+                                continue;
+
+                        for (int k = 0; k < 3; ++k) {
+                                moved[k] = sm->verts[t[k]];
+                                if (t[k] == u || t[k] == v)
+                                        memcpy(moved[k].v, pos,
+                                               sizeof(moved[k].v));
+                        }
+
+                        simplify_tri_get_normal(n_old, sm->verts, t);
+                        simplify_tri_get_normal(n_new, moved, ind);
+                        if (vec3_dot(n_new, n_new) <= SIMPLIFY_AREA_EPS ||
+                            vec3_dot(n_old, n_new) <= SIMPLIFY_FLIP_DOT *
+                            vec3_len(n_old) * vec3_len(n_new))
+                                return false;
+                }
+        }
+
+        return true;
+}
+
+/*
+ * Garland-Heckbert edge collapse: always take the cheapest edge left,
+ * merging its ends where their summed quadric is least, until the mesh
+ * is within both budgets (zero is no limit) or nothing can go.
+ */
+static void simplify_decimate(struct simplify_mesh *sm,
+                              const uint32_t tri_max, const uint32_t vert_max)
+{
+        struct simplify_quadric *quads;
+        struct simplify_list *adj;
+        struct simplify_edge *heap;
+        uint32_t (*edges)[3], *stamps, *remap;
+        uint32_t heap_cnt, heap_cap, live_tris, live_verts, kept, vert_cnt;
+        bool *tri_dead, *vert_dead;
+
+        vert_cnt = sm->vert_cnt; /* `adj` is this long after compacting */
+        quads = calloc(sm->vert_cnt, sizeof(*quads));
+        adj = calloc(sm->vert_cnt, sizeof(*adj));
+        stamps = calloc(sm->vert_cnt, sizeof(*stamps));
+        vert_dead = calloc(sm->vert_cnt, sizeof(*vert_dead));
+        tri_dead = calloc(sm->tri_cnt, sizeof(*tri_dead));
+        edges = malloc(sizeof(*edges) * sm->tri_cnt * 3);
+        simplify_quadrics_init(quads, sm, edges);
+
+        for (uint32_t i = 0; i < sm->tri_cnt; ++i)
+                for (int k = 0; k < 3; ++k)
+                        simplify_list_push(adj + sm->tris[i][k], i);
+
+        live_verts = 0;
+        for (uint32_t i = 0; i < sm->vert_cnt; ++i)
+                live_verts += (adj[i].cnt) ? 1 : 0;
+
+        heap = NULL;
+        heap_cnt = 0;
+        heap_cap = 0;
+        for (uint32_t i = 0; i < sm->tri_cnt * 3; ++i) {
+                struct simplify_edge e;
+
+                if (i && !simplify_edge_cmp(edges[i - 1], edges[i]))
+                        continue;
+
+                simplify_edge_make(&e, sm, quads, stamps, edges[i][0],
+                                   edges[i][1]);
+                simplify_heap_push(&heap, &heap_cnt, &heap_cap, &e);
+        }
+
+        free(edges);
+        live_tris = sm->tri_cnt;
+        while (heap_cnt && ((tri_max && live_tris > tri_max) ||
+                            (vert_max && live_verts > vert_max))) {
+                struct simplify_edge e;
+                struct simplify_list *lu, *lv;
+                uint32_t u, v;
+
+                e = simplify_heap_pop(heap, &heap_cnt);
+                u = e.u;
+                v = e.v;
+                if (vert_dead[u] || vert_dead[v] || stamps[u] != e.stamp_u ||
+                    stamps[v] != e.stamp_v)
+                        continue;
+
+                if (!simplify_collapse_is_valid(sm, adj, tri_dead, u, v,
+                                                e.pos))
+                        continue;
+
+                /* `v` folds into `u` */
+                memcpy(sm->verts[u].v, e.pos, sizeof(e.pos));
+                for (int i = 0; i < 10; ++i)
+                        quads[u].q[i] += quads[v].q[i];
+
+                vert_dead[v] = true;
+                --live_verts;
+                lu = adj + u;
+                lv = adj + v;
+                for (uint32_t j = 0; j < lv->cnt; ++j) {
+                        uint32_t *t;
+
+                        if (tri_dead[lv->v[j]])
+                                continue;
+
+                        t = sm->tris[lv->v[j]];
+                        if (t[0] == u || t[1] == u || t[2] == u) {
+                                tri_dead[lv->v[j]] = true;
+                                --live_tris;
+                                continue;
+                        }
+
+                        for (int k = 0; k < 3; ++k)
+                                if (t[k] == v)
+                                        t[k] = u;
+
+                        simplify_list_push(lu, lv->v[j]);
+                }
+
+                free(lv->v);
+                lv->v = NULL;
+                lv->cnt = 0;
+
+                kept = 0;
+                for (uint32_t j = 0; j < lu->cnt; ++j)
+                        if (!tri_dead[lu->v[j]])
+                                lu->v[kept++] = lu->v[j];
+
+                lu->cnt = kept;
+                ++stamps[u];
+
+                /* Every edge out of `u` now costs something else */
+                for (uint32_t j = 0; j < lu->cnt; ++j) {
+                        const uint32_t *t;
+
+                        t = sm->tris[lu->v[j]];
+                        for (int k = 0; k < 3; ++k) {
+                                struct simplify_edge ne;
+
+                                if (t[k] == u)
+                                        continue;
+
+                                simplify_edge_make(&ne, sm, quads, stamps, u,
+                                                   t[k]);
+                                simplify_heap_push(&heap, &heap_cnt,
+                                                   &heap_cap, &ne);
+                        }
+                }
+        }
+
+        /* Squeeze out what died */
+        remap = malloc(sizeof(*remap) * sm->vert_cnt);
+        kept = 0;
+        for (uint32_t i = 0; i < sm->vert_cnt; ++i) {
+                if (vert_dead[i] || !adj[i].cnt)
+                        continue;
+
+                remap[i] = kept;
+                sm->verts[kept++] = sm->verts[i];
+        }
+
+        sm->vert_cnt = kept;
+        kept = 0;
+        for (uint32_t i = 0; i < sm->tri_cnt; ++i) {
+                if (tri_dead[i])
+                        continue;
+
+                for (int k = 0; k < 3; ++k)
+                        sm->tris[kept][k] = remap[sm->tris[i][k]];
+
+                ++kept;
+        }
+
+        sm->tri_cnt = kept;
+
+        for (uint32_t i = 0; i < vert_cnt; ++i)
+                free(adj[i].v);
+
+        free(remap);
+        free(heap);
+        free(tri_dead);
+        free(vert_dead);
+        free(stamps);
+        free(adj);
+        free(quads);
+}
+
+static uint32_t collision_mesh_get_vert_cnt(const struct collision_mesh *cm)
+{
+        struct simplify_mesh sm;
+        uint32_t cnt;
+
+        simplify_weld(&sm, cm->tris, cm->tri_cnt, 0.f);
+        cnt = sm.vert_cnt;
+        simplify_mesh_free(&sm);
+
+        return cnt;
+}
+
+/*
+ * Welds and drops degenerate triangles throughout, then decimates the
+ * static mesh down to the budget. Convex pieces only get cleaned up, the
+ * decomposition after this decides how many triangles they end up with.
+ */
+static void collision_mesh_simplify(struct collision_mesh *cm,
+                                    const struct convert_opts *opts)
+{
+        struct collision_mesh out;
+        struct collision_piece whole;
+        const struct collision_piece *pieces;
+        uint32_t piece_cnt, static_cnt;
+
+        whole.first = 0;
+        whole.cnt = cm->tri_cnt;
+        whole.flags = 0;
+        pieces = (cm->piece_cnt) ? cm->pieces : &whole;
+        piece_cnt = (cm->piece_cnt) ? cm->piece_cnt : 1;
+        static_cnt = 0;
+        for (uint32_t i = 0; i < piece_cnt; ++i)
+                if (!(pieces[i].flags & COLLISION_PIECE_CONVEX))
+                        static_cnt += pieces[i].cnt;
+
+        collision_mesh_init(&out);
+        out.tris = malloc(sizeof(*out.tris) * cm->tri_cnt);
+        for (uint32_t i = 0; i < piece_cnt; ++i) {
+                const struct collision_piece *p;
+                struct simplify_mesh sm;
+                uint32_t first;
+
+                p = pieces + i;
+                simplify_weld(&sm, cm->tris + p->first, p->cnt, opts->weld);
+                simplify_drop_degenerate(&sm);
+
+                /* Several static pieces share the budget by size */
+                if (!(p->flags & COLLISION_PIECE_CONVEX) &&
+                    (opts->tri_max || opts->vert_max)) {
+                        uint32_t tri_max, vert_max;
+
+                        tri_max = (uint32_t)((uint64_t)opts->tri_max *
+                                             p->cnt / static_cnt);
+                        vert_max = (uint32_t)((uint64_t)opts->vert_max *
+                                              p->cnt / static_cnt);
+                        if (opts->tri_max && !tri_max)
+                                tri_max = 1;
+
+                        if (opts->vert_max && vert_max < 3)
+                                vert_max = 3;
+
+                        simplify_decimate(&sm, tri_max, vert_max);
+                }
+
+                first = out.tri_cnt;
+                for (uint32_t j = 0; j < sm.tri_cnt; ++j) {
+                        struct triangle *t;
+
+                        t = out.tris + out.tri_cnt++;
+                        for (int k = 0; k < 3; ++k)
+                                t->p[k] = sm.verts[sm.tris[j][k]];
+                }
+
+                if (cm->piece_cnt && out.tri_cnt > first)
+                        collision_mesh_push_piece(&out, first,
+                                                  out.tri_cnt - first,
+                                                  p->flags);
+
+                simplify_mesh_free(&sm);
+        }
+
+        collision_mesh_free(cm);
+        *cm = out;
+}
+
+#endif /* SIMPLIFY_C */
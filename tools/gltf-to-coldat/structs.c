@@ -1,6 +1,7 @@
 #ifndef STRUCTS_C
 #define STRUCTS_C
 
+#include <stdbool.h>
 #include <stdint.h>
 
 struct point {
@@ -11,9 +12,71 @@ struct triangle {
         struct point p[3];
 };
 
+#define COLLISION_PIECE_CONVEX (1 << 0) /* Else part of the static mesh */
+#define COLLISION_PIECE_PREFIX "col_" /* Node names that become pieces */
+
+/* A run of triangles in the mesh, as written after them in the .cm */
+struct collision_piece {
+        uint32_t first;
+        uint32_t cnt;
+        uint32_t flags;
+};
+
+/* No pieces means all of it is one static mesh */
 struct collision_mesh {
         uint32_t tri_cnt;
         struct triangle *tris;
+        uint32_t piece_cnt;
+        struct collision_piece *pieces;
+};
+
+/* Every input file cgltf has mapped in for one conversion */
+struct file_map {
+        void *data;
+        size_t sz;
+};
+
+struct file_map_list {
+        struct file_map *maps;
+        int cnt;
+        int cap;
+};
+
+struct name_list {
+        char **names;
+        int cnt;
+        int cap;
+};
+
+/* Anything here that changes the output goes into the cache hash */
+struct convert_opts {
+        float concavity; /* Allowed, as a fraction of a piece's diagonal */
+        int hull_max; /* Per piece */
+        float weld; /* Corners closer than this become one vertex */
+        uint32_t tri_max; /* Budget for the static mesh, zero for none */
+        uint32_t vert_max;
+};
+
+struct convert_result {
+        int ret;
+        uint32_t src_tri_cnt; /* As exported, before any clean up */
+        uint32_t src_vert_cnt;
+        uint32_t tri_cnt;
+        uint32_t vert_cnt;
+        uint32_t piece_cnt;
+        bool cached; /* Output was already up to date */
+        double ms;
+};
+
+/* Shared by every conversion thread, only `next` changes under `lock` */
+struct convert_job {
+        const char *in_path;
+        const char *out_path;
+        struct convert_opts opts;
+        const struct name_list *names;
+        struct convert_result *results;
+        int next;
+        pthread_mutex_t lock;
 };
 
 #endif /* STRUCTS_C */
@@ -1,38 +1,60 @@
 #ifndef UTIL_C
 #define UTIL_C
 
-static char *file_get_buffer(const char *path, size_t *sz)
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Maps all of `path` read only, copy on write. An empty file succeeds
+ * with nothing mapped, since there's nothing to map.
+ */
+static bool file_map_open(const char *path, void **data, size_t *sz)
 {
-        FILE *f;
-        char *buf;
+        struct stat st;
+        int fd;
 
-        f = fopen(path, "rb");
-        if (!f) {
-                printf("Failed to load file from '%s'\n", path);
-                return NULL;
+        *data = NULL;
+        *sz = 0;
+        if ((fd = open(path, O_RDONLY)) < 0)
+                return false;
+
+        if (fstat(fd, &st)) {
+                close(fd);
+                return false;
+        }
+
+        *sz = st.st_size;
+        if (*sz) {
+                *data = mmap(NULL, *sz, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                             fd, 0);
+                if (*data == MAP_FAILED)
+                        *data = NULL;
         }
 
-        fseek(f, 0, SEEK_END);
-        *sz = ftell(f);
-        rewind(f);
-        buf = malloc(*sz + 1);
-        fread(buf, 1, *sz, f);
-        buf[*sz] = 0;
-        fclose(f);
+        close(fd);
 
-        return buf;
+        return !*sz || *data;
 }
 
-static void gltf_get_paths_from_name(char **gltf_path, char **bin_path,
-                                     char **cm_path, const char *indir,
-                                     const char *outdir, const char *obj_name)
+/*
+ * `indir/obj_name.gltf`, or `indir/obj_name.glb` when only that exists,
+ * and `outdir/obj_name.cm`.
+ */
+static void gltf_get_paths_from_name(char **gltf_path, char **cm_path,
+                                     const char *indir, const char *outdir,
+                                     const char *obj_name)
 {
 #define GLTF_EXT_LEN 5
-#define BIN_EXT_LEN 4
 #define CM_EXT_LEN 3
 
         int obj_name_len, indir_len, outdir_len;
-        size_t gltf_path_sz, bin_path_sz, cm_path_sz;
+        size_t gltf_path_sz, cm_path_sz;
+        struct stat st;
 
         obj_name_len = strlen(obj_name);
 
@@ -46,22 +68,174 @@ static void gltf_get_paths_from_name(char **gltf_path, char **bin_path,
 
 
         gltf_path_sz = indir_len + 1 + obj_name_len + GLTF_EXT_LEN + 1;
-        bin_path_sz = indir_len + 1 + obj_name_len + BIN_EXT_LEN + 1;
         cm_path_sz = outdir_len + 1 + obj_name_len + CM_EXT_LEN + 1;
         *gltf_path = malloc(gltf_path_sz);
-        *bin_path = malloc(bin_path_sz);
         *cm_path = malloc(cm_path_sz);
 
         snprintf(*gltf_path, gltf_path_sz, "%.*s/%s.gltf",
                  indir_len, indir, obj_name);
-        snprintf(*bin_path, bin_path_sz, "%.*s/%s.bin",
-                 indir_len, indir, obj_name);
+        if (stat(*gltf_path, &st))
+                snprintf(*gltf_path, gltf_path_sz, "%.*s/%s.glb",
+                         indir_len, indir, obj_name);
+
         snprintf(*cm_path, cm_path_sz, "%.*s/%s.cm",
                  outdir_len, outdir, obj_name);
 
 #undef CM_EXT_LEN
-#undef BIN_EXT_LEN
 #undef GLTF_EXT_LEN
 }
 
+/*
+ * cgltf file callbacks that map inputs instead of reading them into the
+ * heap, so a GLB's binary chunk and external .bin files are used where
+ * they lie in the page cache. Private mappings, so even if cgltf ever
+ * wrote to one it'd only touch its own copy of the page.
+ */
+static cgltf_result file_map_read(const struct cgltf_memory_options *mem,
+                                  const struct cgltf_file_options *opts,
+                                  const char *path, cgltf_size *size,
+                                  void **data)
+{
+        struct file_map_list *list;
+        void *map;
+        size_t sz;
+
+        (void)mem;
+        list = opts->user_data;
+        if (!file_map_open(path, &map, &sz))
+                return (errno == ENOENT) ? cgltf_result_file_not_found :
+                       cgltf_result_io_error;
+
+        /* Shorter than what the glTF says is in there is an error */
+        if (!sz || (size && *size > sz)) {
+                if (map)
+                        munmap(map, sz);
+
+                return cgltf_result_io_error;
+        }
+
+        if (list->cnt >= list->cap) {
+                list->cap = (list->cap) ? list->cap * 2 : 4;
+                list->maps = realloc(list->maps,
+                                     sizeof(*list->maps) * list->cap);
+        }
+
+        list->maps[list->cnt].data = map;
+        list->maps[list->cnt].sz = sz;
+        ++list->cnt;
+        if (size)
+                *size = sz;
+
+        *data = map;
+
+        return cgltf_result_success;
+}
+
+static void file_map_release(const struct cgltf_memory_options *mem,
+                             const struct cgltf_file_options *opts,
+                             void *data)
+{
+        struct file_map_list *list;
+
+        (void)mem;
+        list = opts->user_data;
+        for (int i = 0; i < list->cnt; ++i) {
+                if (list->maps[i].data != data)
+                        continue;
+
+                munmap(data, list->maps[i].sz);
+                list->maps[i] = list->maps[--list->cnt];
+                return;
+        }
+}
+
+static void file_map_list_free(struct file_map_list *list)
+{
+        for (int i = 0; i < list->cnt; ++i)
+                munmap(list->maps[i].data, list->maps[i].sz);
+
+        free(list->maps);
+        list->maps = NULL;
+        list->cnt = 0;
+        list->cap = 0;
+}
+
+static void name_list_init(struct name_list *nl)
+{
+        nl->names = NULL;
+        nl->cnt = 0;
+        nl->cap = 0;
+}
+
+static void name_list_free(struct name_list *nl)
+{
+        for (int i = 0; i < nl->cnt; ++i)
+                free(nl->names[i]);
+
+        free(nl->names);
+        name_list_init(nl);
+}
+
+static void name_list_push_len(struct name_list *nl, const char *name,
+                               const size_t len)
+{
+        char *copy;
+
+        if (nl->cnt >= nl->cap) {
+                nl->cap = (nl->cap) ? nl->cap * 2 : 16;
+                nl->names = realloc(nl->names, sizeof(*nl->names) * nl->cap);
+        }
+
+        copy = malloc(len + 1);
+        memcpy(copy, name, len);
+        copy[len] = 0;
+        nl->names[nl->cnt++] = copy;
+}
+
+static void name_list_push(struct name_list *nl, const char *name)
+{
+        name_list_push_len(nl, name, strlen(name));
+}
+
+/*
+ * One object name per line. Surrounding whitespace is trimmed, and blank
+ * lines and lines starting with '#' are skipped.
+ */
+static bool name_list_push_manifest(struct name_list *nl, const char *path)
+{
+        const char *line, *buf_end;
+        void *buf;
+        size_t buf_sz;
+
+        if (!file_map_open(path, &buf, &buf_sz)) {
+                printf("Failed to load file from '%s'\n", path);
+                return false;
+        }
+
+        line = buf;
+        buf_end = line + buf_sz;
+        while (line < buf_end) {
+                const char *end, *next;
+
+                next = memchr(line, '\n', buf_end - line);
+                end = (next) ? next : buf_end;
+                next = (next) ? next + 1 : end;
+                while (line < end && isspace((unsigned char)*line))
+                        ++line;
+
+                while (end > line && isspace((unsigned char)end[-1]))
+                        --end;
+
+                if (end > line && *line != '#')
+                        name_list_push_len(nl, line, end - line);
+
+                line = next;
+        }
+
+        if (buf)
+                munmap(buf, buf_sz);
+
+        return true;
+}
+
 #endif /* UTIL_C */
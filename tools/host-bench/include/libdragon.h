@@ -0,0 +1,121 @@
+#ifndef LIBDRAGON_H
+#define LIBDRAGON_H
+
+/*
+ * Just enough of libdragon for the collision code to build and run on a
+ * desktop. Nothing here touches hardware.
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Same rate as the N64's count register, so timings read the same. */
+#define TICKS_PER_SECOND 46875000
+#define TICKS_DISTANCE(from, to) ((int32_t)((uint32_t)(to) - (uint32_t)(from)))
+
+static inline uint32_t get_ticks(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint32_t)((uint64_t)ts.tv_sec * TICKS_PER_SECOND +
+                          (uint64_t)ts.tv_nsec * TICKS_PER_SECOND /
+                          1000000000);
+}
+
+/*
+ * The tree prints uint32_t with %lu, which is only right where it's an
+ * unsigned long as on the N64, so the length modifier is dropped here.
+ */
+static inline void debugf(const char *fmt, ...)
+{
+        char host_fmt[256];
+        va_list ap;
+        size_t j;
+
+        j = 0;
+        for (size_t i = 0; fmt[i] && j < sizeof(host_fmt) - 2; ++i) {
+                host_fmt[j++] = fmt[i];
+                if (fmt[i] != '%')
+                        continue;
+
+                if (fmt[i + 1] == '%') {
+                        host_fmt[j++] = fmt[++i];
+                        continue;
+                }
+
+                while (fmt[i + 1] && strchr("-+ #.0123456789", fmt[i + 1]) &&
+                       j < sizeof(host_fmt) - 2)
+                        host_fmt[j++] = fmt[++i];
+
+                if (fmt[i + 1] == 'l' && fmt[i + 2] &&
+                    strchr("diux", fmt[i + 2]))
+                        ++i;
+        }
+
+        host_fmt[j] = '\0';
+        va_start(ap, fmt);
+        vfprintf(stderr, host_fmt, ap);
+        va_end(ap);
+}
+
+#define assertf(expr, ...)                                              \
+        do {                                                            \
+                if (!(expr)) {                                          \
+                        fprintf(stderr, "ASSERTION FAILED: %s\n", #expr); \
+                        debugf(__VA_ARGS__);                            \
+                        fputc('\n', stderr);                            \
+                        abort();                                        \
+                }                                                       \
+        } while (0)
+
+/*
+ * Paths are plain host paths, there's no "rom:/" filesystem. Assets are
+ * built for the big-endian N64, and the only ones loaded here are `.cm`
+ * files, which are nothing but 32-bit words, so they're swapped to host
+ * order in memory on the way in.
+ */
+static inline FILE *asset_fopen(const char *path, int *sz)
+{
+        uint8_t *buf;
+        long len;
+        FILE *f;
+
+        f = fopen(path, "rb");
+        assertf(f, "Couldn't open %s", path);
+        fseek(f, 0, SEEK_END);
+        len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        buf = malloc(len + 1);
+        assertf(buf && fread(buf, 1, len, f) == (size_t)len,
+                "Couldn't read %s", path);
+        fclose(f);
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        for (long i = 0; i + 3 < len; i += 4) {
+                uint8_t t;
+
+                t = buf[i + 0];
+                buf[i + 0] = buf[i + 3];
+                buf[i + 3] = t;
+                t = buf[i + 1];
+                buf[i + 1] = buf[i + 2];
+                buf[i + 2] = t;
+        }
+#endif
+
+        /* Leaks `buf`, the handful of meshes loaded live for the run. */
+        if (sz)
+                *sz = (int)len;
+
+        return fmemopen(buf, len + 1, "rb");
+}
+
+#endif /* LIBDRAGON_H */
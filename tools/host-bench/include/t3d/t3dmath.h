@@ -0,0 +1,72 @@
+#ifndef T3DMATH_H
+#define T3DMATH_H
+
+/* The subset of tiny3d's vector maths the collision code uses. */
+#include <math.h>
+
+typedef union {
+        struct {
+                float x, y, z;
+        };
+        float v[3];
+} T3DVec3;
+
+static inline void t3d_vec3_add(T3DVec3 *res, const T3DVec3 *a,
+                                const T3DVec3 *b)
+{
+        for (int i = 0; i < 3; ++i)
+                res->v[i] = a->v[i] + b->v[i];
+}
+
+static inline void t3d_vec3_diff(T3DVec3 *res, const T3DVec3 *a,
+                                 const T3DVec3 *b)
+{
+        for (int i = 0; i < 3; ++i)
+                res->v[i] = a->v[i] - b->v[i];
+}
+
+static inline void t3d_vec3_scale(T3DVec3 *res, const T3DVec3 *a,
+                                  const float s)
+{
+        for (int i = 0; i < 3; ++i)
+                res->v[i] = a->v[i] * s;
+}
+
+static inline float t3d_vec3_dot(const T3DVec3 *a, const T3DVec3 *b)
+{
+        return a->v[0] * b->v[0] + a->v[1] * b->v[1] + a->v[2] * b->v[2];
+}
+
+static inline float t3d_vec3_len2(const T3DVec3 *a)
+{
+        return t3d_vec3_dot(a, a);
+}
+
+static inline float t3d_vec3_len(const T3DVec3 *a)
+{
+        return sqrtf(t3d_vec3_len2(a));
+}
+
+static inline void t3d_vec3_norm(T3DVec3 *res)
+{
+        float len;
+
+        len = t3d_vec3_len(res);
+        if (len < 0.0001f)
+                return;
+
+        t3d_vec3_scale(res, res, 1.f / len);
+}
+
+static inline void t3d_vec3_cross(T3DVec3 *res, const T3DVec3 *a,
+                                  const T3DVec3 *b)
+{
+        T3DVec3 c;
+
+        c.v[0] = a->v[1] * b->v[2] - a->v[2] * b->v[1];
+        c.v[1] = a->v[2] * b->v[0] - a->v[0] * b->v[2];
+        c.v[2] = a->v[0] * b->v[1] - a->v[1] * b->v[0];
+        *res = c;
+}
+
+#endif /* T3DMATH_H */
@@ -0,0 +1,44 @@
+#include <libdragon.h>
+
+#include "arena.h"
+#include "bench.h"
+#include "collision.h"
+
+#define HOST_ARENA_SIZE (4 * 1024 * 1024)
+#define HOST_SCRATCH_SIZE (1024 * 1024)
+
+/* Runs the debug benchmark over each `.cm` file's hulls, failing on a check. */
+int main(int argc, char **argv)
+{
+        const struct collision_hull *hulls[BENCH_HULL_MAX];
+        struct arena ar, scratch;
+        uint32_t fails;
+        int cnt;
+
+        if (argc < 2) {
+                fprintf(stderr, "usage: %s mesh.cm...\n", argv[0]);
+                return 1;
+        }
+
+        ar = arena_create(HOST_ARENA_SIZE);
+        scratch = arena_create(HOST_SCRATCH_SIZE);
+        cnt = 0;
+        for (int i = 1; i < argc; ++i) {
+                struct collision_data cd;
+
+                cd = collision_data_load(argv[i], &ar, &scratch);
+                for (uint32_t j = 0; j < cd.hull_cnt && cnt < BENCH_HULL_MAX;
+                     ++j)
+                        hulls[cnt++] = cd.hulls + j;
+        }
+
+        fails = bench_run(hulls, cnt);
+        arena_destroy(&scratch);
+        arena_destroy(&ar);
+        if (fails) {
+                fprintf(stderr, "%u checks failed\n", fails);
+                return 1;
+        }
+
+        return 0;
+}